@@ -0,0 +1,440 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "aot.h"
+#include "chunk.h"
+#include "common.h"
+#include "debug.h"
+#include "memory.h"
+#include "object.h"
+#include "stack.h"
+#include "vm.h"
+
+/*------------------------------ the runtime ---------------------------------*/
+
+//the generated function is kept on the function object, calls find it there
+void aot_register(obj_function* function, aot_fn code) {
+     function->aot = (void (*)(void))code;
+}
+
+//the original bytecode is kept so frames have line numbers for errors
+void aot_load_chunk(obj_function* function, const uint8_t* code,
+                    const int* lines, int count) {
+     for (int i = 0; i < count; i++) {
+          write_chunk(&function->chunk, code[i], lines[i]);
+     }
+}
+
+/*   runs functions from the top frame until the script returns. a call
+     returns here to start the callee, and a return to resume the caller at
+     the ip it saved, so the C stack stays flat however deep klox calls go */
+static bool aot_run() {
+     for (;;) {
+          call_frame* frame = &vm.frames[vm.frame_count - 1];
+          aot_status status = ((aot_fn)frame->function->aot)(frame);
+          if (status == AOT_FAILED) return false;
+          if (vm.frame_count == 0) return true;
+     }
+}
+
+aot_status aot_call(int arg_count) {
+     int frame_count = vm.frame_count;
+     if (!call_value(vm.stack_top[-1 - arg_count], arg_count)) return AOT_FAILED;
+
+     //natives have already run by now, functions got a frame
+     return vm.frame_count == frame_count ? AOT_OK : AOT_REENTER;
+}
+
+aot_status aot_tail_call(call_frame* frame, int arg_count) {
+     value callee = vm.stack_top[-1 - arg_count];
+     if (!IS_FUNCTION(callee) || AS_FUNCTION(callee)->arity != arg_count) {
+          return aot_call(arg_count);
+     }
+
+     value* args = vm.stack_top - arg_count - 1;
+     memmove(frame->slots, args, sizeof(value) * (arg_count + 1));
+     vm.stack_top = frame->slots + arg_count + 1;
+     frame->function = AS_FUNCTION(callee);
+     frame->ip = frame->function->chunk.code;
+     return AOT_REENTER;
+}
+
+//runs the script and returns the exit status the interpreter would have
+int aot_main(obj_function* script) {
+     push(OBJ_VAL(script));
+     call_value(OBJ_VAL(script), 0);
+
+     //a push into the guard page ends the program like the interpreter's run
+     bool ok = false;
+     if (sigsetjmp(overflow_jump, 0) != 0) {
+          runtime_error("stack overflow");
+     } else {
+          stack_guarded = true;
+          ok = aot_run();
+          stack_guarded = false;
+     }
+     flush_output(&vm.out);
+     return ok ? 0 : 70;
+}
+
+/*------------------------------ the emitter ---------------------------------*/
+
+typedef struct {
+     FILE* out;
+     obj_function** functions;          //the script first, in load order
+     int count;
+     int capacity;
+} emitter;
+
+static int function_index(emitter* em, obj_function* function) {
+     for (int i = 0; i < em->count; i++) {
+          if (em->functions[i] == function) return i;
+     }
+
+     if (em->capacity < em->count + 1) {
+          int old_capacity = em->capacity;
+          em->capacity = GROW_CAPACITY(old_capacity);
+          em->functions = GROW_ARRAY(em->functions, obj_function*,
+                                     old_capacity, em->capacity);
+     }
+     em->functions[em->count] = function;
+     return em->count++;
+}
+
+static int instruction_length(uint8_t instruction) {
+     switch (instruction) {
+          case OP_CONSTANT:
+          case OP_GET_LOCAL:
+          case OP_SET_LOCAL:
+          case OP_GET_GLOBAL:
+          case OP_DEFINE_GLOBAL:
+          case OP_SET_GLOBAL:
+          case OP_CONCAT:
+          case OP_BUILD_ARRAY:
+          case OP_CALL:
+          case OP_TAIL_CALL:
+               return 2;
+          case OP_JUMP:
+          case OP_JUMP_IF_FALSE:
+          case OP_LOOP:
+               return 3;
+          case OP_CONSTANT_LONG:
+               return 4;
+          case OP_JUMP_IF_LOCAL_NOT_LESS:
+               return 5;
+          case OP_INCREMENT_LOCAL_LOOP:
+               return 6;
+          default:
+               return 1;
+     }
+}
+
+//the bytecode offset a jump at 'offset' goes to, -1 if it is no jump
+static int jump_target(chunk* ch, int offset) {
+     uint8_t* code = ch->code + offset;
+     switch (code[0]) {
+          case OP_JUMP:
+          case OP_JUMP_IF_FALSE:
+               return offset + 3 + ((code[1] << 8) | code[2]);
+          case OP_LOOP:
+               return offset + 3 - ((code[1] << 8) | code[2]);
+          case OP_JUMP_IF_LOCAL_NOT_LESS:
+               return offset + 5 + ((code[3] << 8) | code[4]);
+          case OP_INCREMENT_LOCAL_LOOP:
+               return offset + 6 - ((code[4] << 8) | code[5]);
+          default:
+               return -1;
+     }
+}
+
+static void emit_string(FILE* out, const char* chars, int length) {
+     fputc('"', out);
+     for (int i = 0; i < length; i++) {
+          unsigned char c = (unsigned char)chars[i];
+          if (c == '"' || c == '\\') {
+               fprintf(out, "\\%c", c);
+          } else if (c < ' ' || c > '~' || c == '?') {
+               //octal escapes always take three digits, so the next
+               //character cannot extend them. '?' would start trigraphs
+               fprintf(out, "\\%03o", c);
+          } else {
+               fputc(c, out);
+          }
+     }
+     fputc('"', out);
+}
+
+static void emit_value(emitter* em, value val) {
+     switch (val.type) {
+          case VAL_BOOL:
+               fprintf(em->out, "BOOL_VAL(%s)", AS_BOOL(val) ? "true" : "false");
+               break;
+          case VAL_NULL:
+               fprintf(em->out, "NULL_VAL");
+               break;
+          case VAL_INT:
+               fprintf(em->out, "INT_VAL(INT64_C(%" PRId64 "))", AS_INT(val));
+               break;
+          case VAL_NUMBER: {
+               //the exact bits, so every double (and -0) survives
+               uint64_t bits;
+               double number = AS_DOUBLE(val);
+               memcpy(&bits, &number, sizeof(bits));
+               fprintf(em->out, "aot_double(UINT64_C(0x%016" PRIx64 "))", bits);
+               break;
+          }
+          case VAL_OBJ:
+               if (IS_FUNCTION(val)) {
+                    fprintf(em->out, "OBJ_VAL(functions[%d])",
+                            function_index(em, AS_FUNCTION(val)));
+               } else {
+                    obj_string* string = AS_STRING(val);
+                    fprintf(em->out, "OBJ_VAL(copy_string(");
+                    emit_string(em->out, string->chars, string->length);
+                    fprintf(em->out, ", %d))", string->length);
+               }
+               break;
+     }
+}
+
+static void emit_data(emitter* em, int index) {
+     chunk* ch = &em->functions[index]->chunk;
+
+     fprintf(em->out, "static const uint8_t bytecode_%d[] = {", index);
+     for (int i = 0; i < ch->count; i++) {
+          fprintf(em->out, "%s%d,", i % 16 == 0 ? "\n     " : " ", ch->code[i]);
+     }
+     fprintf(em->out, "\n};\n");
+
+     fprintf(em->out, "static const int lines_%d[] = {", index);
+     for (int i = 0; i < ch->count; i++) {
+          fprintf(em->out, "%s%d,", i % 16 == 0 ? "\n     " : " ", ch->lines[i]);
+     }
+     fprintf(em->out, "\n};\n\n");
+}
+
+static void emit_instruction(emitter* em, chunk* ch, int offset) {
+     FILE* out = em->out;
+     uint8_t* code = ch->code + offset;
+     int next = offset + instruction_length(code[0]);
+     int target = jump_target(ch, offset);
+
+     fprintf(out, "     ");
+     switch (code[0]) {
+          case OP_CONSTANT:
+               fprintf(out, "AOT_PUSH(constants[%d]);", code[1]);
+               break;
+          case OP_CONSTANT_LONG:
+               fprintf(out, "AOT_PUSH(constants[%d]);",
+                       code[1] | (code[2] << 8) | (code[3] << 16));
+               break;
+          case OP_NULL:  fprintf(out, "AOT_PUSH(NULL_VAL);"); break;
+          case OP_TRUE:  fprintf(out, "AOT_PUSH(BOOL_VAL(true));"); break;
+          case OP_FALSE: fprintf(out, "AOT_PUSH(BOOL_VAL(false));"); break;
+          case OP_POP:   fprintf(out, "AOT_POP();"); break;
+          case OP_GET_LOCAL:
+               fprintf(out, "AOT_PUSH(slots[%d]);", code[1]);
+               break;
+          case OP_SET_LOCAL:
+               fprintf(out, "AOT_SET_LOCAL(%d);", code[1]);
+               break;
+          case OP_GET_GLOBAL:
+               fprintf(out, "AOT_GET_GLOBAL(AS_STRING(constants[%d]), %d);",
+                       code[1], next);
+               break;
+          case OP_DEFINE_GLOBAL:
+               fprintf(out, "AOT_DEFINE_GLOBAL(AS_STRING(constants[%d]));",
+                       code[1]);
+               break;
+          case OP_SET_GLOBAL:
+               fprintf(out, "AOT_SET_GLOBAL(AS_STRING(constants[%d]), %d);",
+                       code[1], next);
+               break;
+          case OP_EQUAL:        fprintf(out, "AOT_EQUAL();"); break;
+          case OP_GREATER:      fprintf(out, "AOT_COMPARE(>, %d);", next); break;
+          case OP_LESS:         fprintf(out, "AOT_COMPARE(<, %d);", next); break;
+          case OP_ADD:          fprintf(out, "AOT_ADD(%d);", next); break;
+          case OP_CONCAT:
+               fprintf(out, "AOT_CONCAT(%d, %d);", code[1], next);
+               break;
+          case OP_SUBTRACT:
+               fprintf(out, "AOT_BINARY_OP(subtract_numbers, %d);", next);
+               break;
+          case OP_MULTIPLY:
+               fprintf(out, "AOT_BINARY_OP(multiply_numbers, %d);", next);
+               break;
+          case OP_DIVIDE:
+               fprintf(out, "AOT_BINARY_OP(divide_numbers, %d);", next);
+               break;
+          case OP_NOT:          fprintf(out, "AOT_NOT();"); break;
+          case OP_NEGATE:       fprintf(out, "AOT_NEGATE(%d);", next); break;
+          case OP_ADD_NUM:      fprintf(out, "AOT_NUMBER_OP(add_numbers);"); break;
+          case OP_ADD_STR:      fprintf(out, "AOT_CONCATENATE();"); break;
+          case OP_SUBTRACT_NUM:
+               fprintf(out, "AOT_NUMBER_OP(subtract_numbers);");
+               break;
+          case OP_MULTIPLY_NUM:
+               fprintf(out, "AOT_NUMBER_OP(multiply_numbers);");
+               break;
+          case OP_DIVIDE_NUM:
+               fprintf(out, "AOT_NUMBER_OP(divide_numbers);");
+               break;
+          case OP_GREATER_NUM:  fprintf(out, "AOT_COMPARE_NUMBERS(>);"); break;
+          case OP_LESS_NUM:     fprintf(out, "AOT_COMPARE_NUMBERS(<);"); break;
+          case OP_NOT_BOOL:     fprintf(out, "AOT_NOT_BOOL();"); break;
+          case OP_NEGATE_NUM:   fprintf(out, "AOT_NEGATE_NUM();"); break;
+          case OP_PRINT:        fprintf(out, "AOT_PRINT();"); break;
+          case OP_BUILD_ARRAY:
+               fprintf(out, "AOT_BUILD_ARRAY(%d);", code[1]);
+               break;
+          case OP_INDEX_GET:    fprintf(out, "AOT_INDEX_GET(%d);", next); break;
+          case OP_INDEX_SET:    fprintf(out, "AOT_INDEX_SET(%d);", next); break;
+          case OP_CALL:
+               fprintf(out, "AOT_CALL(%d, %d);", code[1], next);
+               break;
+          case OP_TAIL_CALL:
+               fprintf(out, "AOT_TAIL_CALL(%d, %d);", code[1], next);
+               break;
+          case OP_JUMP:
+          case OP_LOOP:
+               fprintf(out, "goto l%d;", target);
+               break;
+          case OP_JUMP_IF_FALSE:
+               fprintf(out, "AOT_JUMP_IF_FALSE(l%d);", target);
+               break;
+          case OP_JUMP_IF_LOCAL_NOT_LESS:
+               fprintf(out, "AOT_JUMP_IF_LOCAL_NOT_LESS(%d, constants[%d], l%d, %d);",
+                       code[1], code[2], target, next);
+               break;
+          case OP_INCREMENT_LOCAL_LOOP:
+               fprintf(out, "AOT_INCREMENT_LOCAL_LOOP(%d, constants[%d], "
+                       "constants[%d], l%d, %d);",
+                       code[1], code[2], code[3], target, next);
+               break;
+          case OP_COUNT:
+               fprintf(out, "AOT_COUNT(%d);", ch->lines[offset]);
+               break;
+          case OP_RETURN:       fprintf(out, "AOT_RETURN();"); break;
+          default:
+               fprintf(out, "#error unknown opcode %d", code[0]);
+               break;
+     }
+     fprintf(out, " //%04d %s\n", offset, opcode_name(code[0]));
+}
+
+static void emit_function(emitter* em, int index) {
+     obj_function* function = em->functions[index];
+     chunk* ch = &function->chunk;
+
+     /*   only jump targets get labels, so the compiler sees no unused ones.
+          the instruction after a call is where the function is resumed
+          when the callee returns */
+     bool* targets = ALLOCATE(bool, ch->count + 1);
+     bool* resumes = ALLOCATE(bool, ch->count + 1);
+     memset(targets, 0, ch->count + 1);
+     memset(resumes, 0, ch->count + 1);
+     bool calls = false;
+     for (int offset = 0; offset < ch->count;
+          offset += instruction_length(ch->code[offset])) {
+          int target = jump_target(ch, offset);
+          if (target >= 0) targets[target] = true;
+
+          uint8_t instruction = ch->code[offset];
+          if (instruction == OP_CALL || instruction == OP_TAIL_CALL) {
+               int next = offset + instruction_length(instruction);
+               targets[next] = resumes[next] = calls = true;
+          }
+     }
+
+     fprintf(em->out, "//%s\n", function->name == NULL ? "<script>"
+                                                        : function->name->chars);
+     fprintf(em->out, "static aot_status code_%d(call_frame* frame) {\n", index);
+     fprintf(em->out, "     uint8_t* code = frame->function->chunk.code;\n");
+     fprintf(em->out, "     value* constants = "
+                      "frame->function->chunk.constants.values;\n");
+     fprintf(em->out, "     value* slots = frame->slots;\n");
+     fprintf(em->out, "     value* sp = vm.stack_top;\n");
+     fprintf(em->out, "     (void)code;\n     (void)constants;\n\n");
+
+     if (calls) {
+          fprintf(em->out, "     switch (frame->ip - code) {\n");
+          for (int offset = 0; offset <= ch->count; offset++) {
+               if (resumes[offset]) {
+                    fprintf(em->out, "          case %d: goto l%d;\n",
+                            offset, offset);
+               }
+          }
+          fprintf(em->out, "     }\n\n");
+     }
+
+     for (int offset = 0; offset < ch->count;
+          offset += instruction_length(ch->code[offset])) {
+          if (targets[offset]) fprintf(em->out, "l%d:\n", offset);
+          emit_instruction(em, ch, offset);
+     }
+     fprintf(em->out, "}\n\n");
+
+     FREE_ARRAY(bool, targets, ch->count + 1);
+     FREE_ARRAY(bool, resumes, ch->count + 1);
+}
+
+/*   writes a program that runs 'script' the way the interpreter would. the
+     functions it declares are found through the constant pools, and are
+     all created up front so their constants can refer to each other */
+void emit_c(obj_function* script, FILE* out, const char* source_name) {
+     emitter em = { out, NULL, 0, 0 };
+     function_index(&em, script);
+
+     //numbering the functions walks the constant pools as the list grows
+     for (int i = 0; i < em.count; i++) {
+          val_array* constants = &em.functions[i]->chunk.constants;
+          for (int j = 0; j < constants->count; j++) {
+               if (IS_FUNCTION(constants->values[j])) {
+                    function_index(&em, AS_FUNCTION(constants->values[j]));
+               }
+          }
+     }
+
+     fprintf(out, "//generated by klox --emit-c from %s\n", source_name);
+     fprintf(out, "#include \"aot.h\"\n\n");
+     fprintf(out, "static obj_function* functions[%d];\n\n", em.count);
+
+     for (int i = 0; i < em.count; i++) emit_data(&em, i);
+     for (int i = 0; i < em.count; i++) emit_function(&em, i);
+
+     fprintf(out, "static void load() {\n");
+     fprintf(out, "     for (int i = 0; i < %d; i++) "
+                  "functions[i] = new_function();\n\n", em.count);
+     for (int i = 0; i < em.count; i++) {
+          obj_function* function = em.functions[i];
+          val_array* constants = &function->chunk.constants;
+
+          fprintf(out, "     functions[%d]->arity = %d;\n", i, function->arity);
+          if (function->name != NULL) {
+               fprintf(out, "     functions[%d]->name = copy_string(", i);
+               emit_string(out, function->name->chars, function->name->length);
+               fprintf(out, ", %d);\n", function->name->length);
+          }
+          fprintf(out, "     aot_load_chunk(functions[%d], bytecode_%d, "
+                       "lines_%d, %d);\n", i, i, i, function->chunk.count);
+          for (int j = 0; j < constants->count; j++) {
+               fprintf(out, "     write_val_array(&functions[%d]->chunk.constants, ",
+                       i);
+               emit_value(&em, constants->values[j]);
+               fprintf(out, ");\n");
+          }
+          fprintf(out, "     aot_register(functions[%d], code_%d);\n\n", i, i);
+     }
+     fprintf(out, "}\n\n");
+
+     fprintf(out, "int main() {\n");
+     fprintf(out, "     init_vm();\n");
+     fprintf(out, "     load();\n");
+     fprintf(out, "     int status = aot_main(functions[0]);\n");
+     fprintf(out, "     free_vm();\n");
+     fprintf(out, "     return status;\n");
+     fprintf(out, "}\n");
+
+     FREE_ARRAY(obj_function*, em.functions, em.capacity);
+}
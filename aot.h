@@ -0,0 +1,249 @@
+#ifndef klox_aot_h
+#define klox_aot_h
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+#include "coverage.h"
+#include "object.h"
+#include "output.h"
+#include "table.h"
+#include "value.h"
+#include "vm.h"
+
+/*   ahead-of-time translation of compiled scripts to C. emit_c writes a
+     translation unit with one C function per klox function, where every
+     instruction became a use of the macros below. they do exactly what the
+     interpreter's handlers do, on a stack pointer kept in a local, and call
+     into the same runtime. calls do not recurse in C: a generated function
+     returns to aot_run when it calls a klox function, and is resumed after
+     the call once the callee returns, so call depth is only limited by the
+     value stack like the interpreter's. the program it builds links against
+     the klox runtime objects (everything except main.o) */
+
+typedef enum {
+     AOT_OK,                  //returned, or a call has already finished
+     AOT_REENTER,             //a call or tail call put a function on top
+     AOT_FAILED               //a runtime error was reported
+} aot_status;
+
+typedef aot_status (*aot_fn)(call_frame* frame);
+
+void emit_c(obj_function* script, FILE* out, const char* source_name);
+
+//used by the generated code
+void aot_register(obj_function* function, aot_fn code);
+void aot_load_chunk(obj_function* function, const uint8_t* code,
+                    const int* lines, int count);
+aot_status aot_call(int arg_count);
+aot_status aot_tail_call(call_frame* frame, int arg_count);
+int aot_main(obj_function* script);
+
+static inline value aot_double(uint64_t bits) {
+     double number;
+     memcpy(&number, &bits, sizeof(number));
+     return NUMBER_VAL(number);
+}
+
+//every generated function has 'frame', 'code', 'slots' and 'sp' in scope.
+//'next' is the offset of the following instruction, where the interpreter's
+//ip would point while running this one
+#define AOT_SYNC(next) (frame->ip = code + (next), vm.stack_top = sp)
+#define AOT_FAIL(next, ...) \
+     do { \
+          AOT_SYNC(next); \
+          runtime_error(__VA_ARGS__); \
+          return AOT_FAILED; \
+     } while (false)
+
+#define AOT_PUSH(val) (*sp++ = (val))
+#define AOT_POP() (sp--)
+#define AOT_SET_LOCAL(slot) (slots[slot] = sp[-1])
+
+#define AOT_GET_GLOBAL(name, next) \
+     do { \
+          if (!table_get(&vm.globals, name, sp)) { \
+               AOT_FAIL(next, "undefined variable '%s'", (name)->chars); \
+          } \
+          sp++; \
+     } while (false)
+#define AOT_DEFINE_GLOBAL(name) \
+     do { \
+          table_set(&vm.globals, name, sp[-1]); \
+          sp--; \
+     } while (false)
+#define AOT_SET_GLOBAL(name, next) \
+     do { \
+          if (table_set(&vm.globals, name, sp[-1])) { \
+               table_delete(&vm.globals, name); \
+               AOT_FAIL(next, "undefined variable '%s'", (name)->chars); \
+          } \
+     } while (false)
+
+#define AOT_EQUAL() \
+     do { \
+          sp[-2] = BOOL_VAL(values_equal(sp[-2], sp[-1])); \
+          sp--; \
+     } while (false)
+#define AOT_COMPARE_NUMBERS(op) \
+     do { \
+          if (IS_INT(sp[-2]) && IS_INT(sp[-1])) { \
+               sp[-2] = BOOL_VAL(AS_INT(sp[-2]) op AS_INT(sp[-1])); \
+          } else { \
+               sp[-2] = BOOL_VAL(AS_NUMBER(sp[-2]) op AS_NUMBER(sp[-1])); \
+          } \
+          sp--; \
+     } while (false)
+#define AOT_COMPARE(op, next) \
+     do { \
+          if (!(IS_INT(sp[-2]) && IS_INT(sp[-1])) && \
+                    (!IS_NUMBER(sp[-1]) || !IS_NUMBER(sp[-2]))) { \
+               AOT_FAIL(next, "operands must be numbers"); \
+          } \
+          AOT_COMPARE_NUMBERS(op); \
+     } while (false)
+
+#define AOT_NUMBER_OP(fn) \
+     do { \
+          sp[-2] = fn(sp[-2], sp[-1]); \
+          sp--; \
+     } while (false)
+#define AOT_BINARY_OP(fn, next) \
+     do { \
+          if (!IS_NUMBER(sp[-1]) || !IS_NUMBER(sp[-2])) { \
+               AOT_FAIL(next, "operands must be numbers"); \
+          } \
+          AOT_NUMBER_OP(fn); \
+     } while (false)
+#define AOT_CONCATENATE() \
+     do { \
+          vm.stack_top = sp; \
+          concatenate(); \
+          sp = vm.stack_top; \
+     } while (false)
+#define AOT_ADD(next) \
+     do { \
+          if (IS_STRING(sp[-1]) && IS_STRING(sp[-2])) { \
+               AOT_CONCATENATE(); \
+          } else if (IS_NUMBER(sp[-1]) && IS_NUMBER(sp[-2])) { \
+               AOT_NUMBER_OP(add_numbers); \
+          } else { \
+               AOT_FAIL(next, "operands to addition must be numbers or strings"); \
+          } \
+     } while (false)
+
+#define AOT_CONCAT(count, next) \
+     do { \
+          vm.stack_top = sp; \
+          if (!add_all(count)) { \
+               AOT_FAIL(next, "operands to addition must be numbers or strings"); \
+          } \
+          sp = vm.stack_top; \
+     } while (false)
+
+#define AOT_NOT() (sp[-1] = BOOL_VAL(is_falsey(sp[-1])))
+#define AOT_NOT_BOOL() (sp[-1] = BOOL_VAL(!AS_BOOL(sp[-1])))
+#define AOT_NEGATE_NUM() (sp[-1] = negate_number(sp[-1]))
+#define AOT_NEGATE(next) \
+     do { \
+          if (!IS_NUMBER(sp[-1])) AOT_FAIL(next, "operand must be a number"); \
+          AOT_NEGATE_NUM(); \
+     } while (false)
+
+#define AOT_PRINT() \
+     do { \
+          write_value(&vm.out, sp[-1]); \
+          write_char(&vm.out, '\n'); \
+          sp--; \
+     } while (false)
+
+#define AOT_JUMP_IF_FALSE(label) \
+     do { \
+          if (is_falsey(sp[-1])) goto label; \
+     } while (false)
+#define AOT_JUMP_IF_LOCAL_NOT_LESS(slot, limit, label, next) \
+     do { \
+          value* local_ = &slots[slot]; \
+          if (IS_INT(*local_) && IS_INT(limit)) { \
+               if (!(AS_INT(*local_) < AS_INT(limit))) goto label; \
+          } else if (IS_NUMBER(*local_)) { \
+               if (!(AS_NUMBER(*local_) < AS_NUMBER(limit))) goto label; \
+          } else { \
+               AOT_FAIL(next, "operands must be numbers"); \
+          } \
+     } while (false)
+#define AOT_INCREMENT_LOCAL_LOOP(slot, step, limit, label, next) \
+     do { \
+          value* local_ = &slots[slot]; \
+          if (!IS_NUMBER(*local_)) { \
+               AOT_FAIL(next, "operands to addition must be numbers or strings"); \
+          } \
+          *local_ = add_numbers(*local_, step); \
+          if (IS_INT(*local_) && IS_INT(limit)) { \
+               if (AS_INT(*local_) < AS_INT(limit)) goto label; \
+          } else if (AS_NUMBER(*local_) < AS_NUMBER(limit)) { \
+               goto label; \
+          } \
+     } while (false)
+
+#define AOT_BUILD_ARRAY(count) \
+     do { \
+          obj_array* array_ = new_array(); \
+          for (value* element_ = sp - (count); element_ < sp; element_++) { \
+               write_val_array(&array_->items, *element_); \
+          } \
+          sp -= (count); \
+          AOT_PUSH(OBJ_VAL(array_)); \
+     } while (false)
+#define AOT_INDEX_GET(next) \
+     do { \
+          if (!IS_ARRAY(sp[-2])) AOT_FAIL(next, "can only index arrays"); \
+          obj_array* array_ = AS_ARRAY(sp[-2]); \
+          int slot_; \
+          AOT_SYNC(next); \
+          if (!array_index(array_, sp[-1], &slot_)) return AOT_FAILED; \
+          sp[-2] = array_->items.values[slot_]; \
+          sp--; \
+     } while (false)
+#define AOT_INDEX_SET(next) \
+     do { \
+          if (!IS_ARRAY(sp[-3])) AOT_FAIL(next, "can only index arrays"); \
+          obj_array* array_ = AS_ARRAY(sp[-3]); \
+          int slot_; \
+          AOT_SYNC(next); \
+          if (!array_index(array_, sp[-2], &slot_)) return AOT_FAILED; \
+          array_->items.values[slot_] = sp[-1]; \
+          sp[-3] = sp[-1]; \
+          sp -= 2; \
+     } while (false)
+
+//a call to a function leaves it to aot_run to start the callee and to
+//resume this function at 'next' once it returns. natives run right here
+#define AOT_CALL(arg_count, next) \
+     do { \
+          AOT_SYNC(next); \
+          aot_status status_ = aot_call(arg_count); \
+          if (status_ != AOT_OK) return status_; \
+          sp = vm.stack_top; \
+     } while (false)
+//a tail call to a function reuses the frame instead, anything else is an
+//ordinary call
+#define AOT_TAIL_CALL(arg_count, next) \
+     do { \
+          AOT_SYNC(next); \
+          aot_status status_ = aot_tail_call(frame, arg_count); \
+          if (status_ != AOT_OK) return status_; \
+          sp = vm.stack_top; \
+     } while (false)
+#define AOT_COUNT(line) (coverage.counts[line]++)
+#define AOT_RETURN() \
+     do { \
+          value result_ = sp[-1]; \
+          vm.frame_count--; \
+          vm.stack_top = slots; \
+          if (vm.frame_count > 0) *vm.stack_top++ = result_; \
+          return AOT_OK; \
+     } while (false)
+
+#endif
@@ -0,0 +1,55 @@
+#include <string.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+
+//blocks start at multiples of this, enough for any value
+#define ARENA_ALIGN 8
+
+void init_arena(arena* a, size_t size) {
+     size = (size + 4095) & ~(size_t)4095;
+     a->used = 0;
+     a->size = size;
+     a->touched = 0;
+     a->base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+     if (a->base == MAP_FAILED) {
+          a->base = NULL;
+          a->size = 0;
+     }
+}
+
+void free_arena(arena* a) {
+     if (a->base != NULL) munmap(a->base, a->size);
+     a->base = NULL;
+     a->used = 0;
+     a->size = 0;
+     a->touched = 0;
+}
+
+void trim_arena(arena* a, size_t keep) {
+     keep = (keep + 4095) & ~(size_t)4095;
+     if (a->base == NULL || a->touched <= keep) return;
+     madvise(a->base + keep, a->touched - keep, MADV_DONTNEED);
+     a->touched = keep;
+}
+
+void* arena_grow(arena* a, void* block, size_t old_size, size_t new_size) {
+     if (a->base == NULL) return NULL;
+
+     //the newest block ends where the free space starts
+     if (block != NULL && (uint8_t*)block + old_size == a->base + a->used) {
+          size_t start = (uint8_t*)block - a->base;
+          if (new_size > a->size - start) return NULL;
+          a->used = start + new_size;
+          if (a->used > a->touched) a->touched = a->used;
+          return block;
+     }
+
+     size_t start = (a->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+     if (start > a->size || new_size > a->size - start) return NULL;
+     a->used = start + new_size;
+     if (a->used > a->touched) a->touched = a->used;
+     if (block != NULL) memcpy(a->base + start, block, old_size);
+     return a->base + start;
+}
@@ -0,0 +1,43 @@
+#ifndef klox_arena_h
+#define klox_arena_h
+
+#include "common.h"
+
+/*   a bump allocator over one reservation of address space, which the
+     kernel only backs with memory as it is touched. allocations are freed
+     all at once, by releasing back to an earlier mark, so the newest one
+     can always grow in place */
+typedef struct {
+     uint8_t* base;
+     size_t used;
+     size_t size;
+     size_t touched;          //the most that was ever used, since the last trim
+} arena;
+
+//an arena that cannot be reserved is left empty, every allocation then fails
+void init_arena(arena* a, size_t size);
+void free_arena(arena* a);
+
+//gives the memory backing all but the first 'keep' bytes back to the kernel
+void trim_arena(arena* a, size_t keep);
+
+/*   resizes 'block', which is NULL or was returned by this arena, to
+     'new_size' bytes. the newest block grows in place, any other is copied
+     to the top. returns NULL once the reservation is used up */
+void* arena_grow(arena* a, void* block, size_t old_size, size_t new_size);
+
+static inline bool arena_owns(arena* a, const void* block) {
+     return a->base != NULL && (const uint8_t*)block >= a->base &&
+            (const uint8_t*)block < a->base + a->size;
+}
+
+static inline size_t arena_mark(arena* a) {
+     return a->used;
+}
+
+//forgets everything allocated since 'mark' was taken
+static inline void arena_release(arena* a, size_t mark) {
+     a->used = mark;
+}
+
+#endif
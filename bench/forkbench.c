@@ -0,0 +1,236 @@
+/*   latency of one-shot scripts: runs a job many times as a cold klox
+     process and through a fork server started with the same prelude, and
+     reports percentiles of both. a cold run executes the prelude followed by
+     the job, which is the work a fork server worker skips */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_RUNS 10000
+
+static const char* klox = "./klox";
+
+static double now_ms() {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static char* read_file(const char* path, size_t* length) {
+     FILE* file = fopen(path, "rb");
+     if (file == NULL) {
+          fprintf(stderr, "could not open file \"%s\".\n", path);
+          exit(74);
+     }
+
+     fseek(file, 0L, SEEK_END);
+     *length = ftell(file);
+     rewind(file);
+
+     char* buffer = malloc(*length + 1);
+     if (buffer == NULL || fread(buffer, 1, *length, file) < *length) {
+          fprintf(stderr, "could not read file \"%s\".\n", path);
+          exit(74);
+     }
+     buffer[*length] = '\0';
+     fclose(file);
+     return buffer;
+}
+
+//runs klox with the given arguments, output discarded, and waits for it
+static pid_t spawn(const char* const* args, bool wait_for_it, int* status) {
+     pid_t pid = fork();
+     if (pid < 0) return -1;
+
+     if (pid == 0) {
+          FILE* null = fopen("/dev/null", "w");
+          dup2(fileno(null), STDOUT_FILENO);
+          dup2(fileno(null), STDERR_FILENO);
+          execv(klox, (char* const*)args);
+          _exit(127);
+     }
+
+     if (wait_for_it) {
+          while (waitpid(pid, status, 0) < 0) {
+               if (errno != EINTR) return -1;
+          }
+     }
+     return pid;
+}
+
+static double cold_run(const char* path) {
+     const char* args[] = { klox, path, NULL };
+     double start = now_ms();
+     int status;
+     if (spawn(args, true, &status) < 0) return -1;
+     double elapsed = now_ms() - start;
+
+     if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+     return elapsed;
+}
+
+static int connect_to(const char* socket_path) {
+     struct sockaddr_un address;
+     memset(&address, 0, sizeof(address));
+     address.sun_family = AF_UNIX;
+     snprintf(address.sun_path, sizeof(address.sun_path), "%s", socket_path);
+
+     int conn = socket(AF_UNIX, SOCK_STREAM, 0);
+     if (conn < 0) return -1;
+     if (connect(conn, (struct sockaddr*)&address, sizeof(address)) != 0) {
+          close(conn);
+          return -1;
+     }
+     return conn;
+}
+
+//one job through the server, timed until the worker's exit status arrives
+static double warm_run(const char* socket_path, const char* job, size_t length) {
+     double start = now_ms();
+     int conn = connect_to(socket_path);
+     if (conn < 0) return -1;
+
+     if (write(conn, job, length) != (ssize_t)length) {
+          close(conn);
+          return -1;
+     }
+     shutdown(conn, SHUT_WR);
+
+     //only the trailer after the NUL matters here
+     char buffer[4096];
+     char trailer[64] = "";
+     int trailer_length = 0;
+     bool in_trailer = false;
+     ssize_t bytes;
+     while ((bytes = read(conn, buffer, sizeof(buffer))) > 0) {
+          for (ssize_t i = 0; i < bytes; i++) {
+               if (in_trailer) {
+                    if (trailer_length < (int)sizeof(trailer) - 1) {
+                         trailer[trailer_length++] = buffer[i];
+                    }
+               } else if (buffer[i] == '\0') {
+                    in_trailer = true;
+               }
+          }
+     }
+     close(conn);
+     double elapsed = now_ms() - start;
+
+     trailer[trailer_length] = '\0';
+     if (strcmp(trailer, "exit 0\n") != 0) return -1;
+     return elapsed;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+     double x = *(const double*)a;
+     double y = *(const double*)b;
+     return (x > y) - (x < y);
+}
+
+//nearest-rank percentile over an already sorted sample
+static double percentile(double* sorted, int count, double pct) {
+     int rank = (int)(pct / 100.0 * count + 0.999999);
+     if (rank < 1) rank = 1;
+     if (rank > count) rank = count;
+     return sorted[rank - 1];
+}
+
+static void report(const char* name, double* samples, int runs) {
+     qsort(samples, runs, sizeof(double), compare_doubles);
+     printf("%-20s %10.3f %10.3f %10.3f %10.3f\n", name, samples[0],
+            percentile(samples, runs, 50), percentile(samples, runs, 90),
+            percentile(samples, runs, 99));
+}
+
+static void usage() {
+     fprintf(stderr, "usage: forkbench [-k klox] [-n runs] [-p prelude] job\n");
+     exit(64);
+}
+
+int main(int argc, char* argv[]) {
+     int runs = 200;
+     const char* prelude_path = NULL;
+
+     int opt;
+     while ((opt = getopt(argc, argv, "k:n:p:")) != -1) {
+          switch (opt) {
+               case 'k': klox = optarg; break;
+               case 'n': runs = atoi(optarg); break;
+               case 'p': prelude_path = optarg; break;
+               default: usage();
+          }
+     }
+     if (optind + 1 != argc || runs < 1 || runs > MAX_RUNS) usage();
+
+     size_t job_length;
+     char* job = read_file(argv[optind], &job_length);
+
+     //the cold runs get the prelude and the job in one file
+     char cold_path[] = "/tmp/forkbench-XXXXXX";
+     int cold_fd = mkstemp(cold_path);
+     if (cold_fd < 0) {
+          fprintf(stderr, "could not create a temporary file.\n");
+          return 74;
+     }
+     if (prelude_path != NULL) {
+          size_t prelude_length;
+          char* prelude = read_file(prelude_path, &prelude_length);
+          (void)!write(cold_fd, prelude, prelude_length);
+          (void)!write(cold_fd, "\n", 1);
+          free(prelude);
+     }
+     (void)!write(cold_fd, job, job_length);
+     close(cold_fd);
+
+     char socket_path[64];
+     snprintf(socket_path, sizeof(socket_path), "/tmp/forkbench-%d.sock",
+              (int)getpid());
+     const char* server_args[] = {
+          klox, "--fork-server", socket_path, prelude_path, NULL
+     };
+     int status;
+     pid_t server = spawn(server_args, false, &status);
+
+     //wait for the server to listen
+     int conn = -1;
+     for (int i = 0; i < 500 && conn < 0; i++) {
+          conn = connect_to(socket_path);
+          if (conn < 0) usleep(10000);
+     }
+     bool failed = conn < 0;
+     if (conn >= 0) close(conn);
+
+     static double cold[MAX_RUNS];
+     static double warm[MAX_RUNS];
+     for (int i = 0; i < runs && !failed; i++) {
+          cold[i] = cold_run(cold_path);
+          warm[i] = warm_run(socket_path, job, job_length);
+          failed = cold[i] < 0 || warm[i] < 0;
+     }
+
+     kill(server, SIGTERM);
+     waitpid(server, &status, 0);
+     unlink(socket_path);
+     unlink(cold_path);
+     free(job);
+
+     if (failed) {
+          fprintf(stderr, "a run failed.\n");
+          return 1;
+     }
+
+     printf("%-20s %10s %10s %10s %10s\n", "latency", "min ms", "p50 ms",
+            "p90 ms", "p99 ms");
+     report("cold klox", cold, runs);
+     report("fork server", warm, runs);
+     return 0;
+}
@@ -0,0 +1,136 @@
+#!/bin/sh
+# generates the large klox workloads used by 'make bench' into the given
+# directory. they are generated rather than checked in because they are big
+# and repetitive, and so their size can be tuned in one place.
+
+out=${1:-bench/build}
+mkdir -p "$out"
+
+# straight-line arithmetic on locals, the closest thing to a hot loop body
+awk 'BEGIN {
+     print "{";
+     print "     let a = 1.5; let b = 2; let c = 3; let d = 0.25;";
+     for (i = 0; i < 20000; i++) {
+          print "     a = a + b * c; a = a - b * c;";
+          print "     c = c * d; c = c / d;";
+          print "     b = -b; b = -b;";
+     }
+     print "     print a + b + c + d;";
+     print "}";
+}' > "$out/arith.klx"
+
+# repeated reads and writes of a pool of globals through the globals table
+awk 'BEGIN {
+     n = 64;
+     for (i = 0; i < n; i++) printf "let g%d = %d;\n", i, i;
+     for (i = 0; i < 40000; i++) {
+          k = (i * 13 + 5) % n;
+          printf "g%d = g%d + g%d - g%d;\n", i % n, (i * 7) % n, k, k;
+     }
+     print "print g0;";
+}' > "$out/globals.klx"
+
+# repeated concatenation, each result is allocated, hashed and interned
+awk 'BEGIN {
+     print "{";
+     print "     let s = \"\"; let t = \"abcdefgh\"; let u = \"\";";
+     for (i = 0; i < 3000; i++) {
+          print "     s = s + t; u = t + t + t;";
+     }
+     print "     print s == u;";
+     print "}";
+}' > "$out/strings.klx"
+
+# chains of + joining literals and locals into one string each time
+awk 'BEGIN {
+     print "func row(key, value, unit) {";
+     print "     return \"<\" + key + \": \" + value + \" \" + unit + \">\";";
+     print "}";
+     print "{";
+     print "     let i = 0; let s = \"\";";
+     print "     while (i < 300000) { s = row(\"width\", \"12\", \"px\"); i = i + 1; }";
+     print "     print s;";
+     print "}";
+}' > "$out/concat.klx"
+
+# deeply nested blocks declaring and shadowing locals
+awk 'BEGIN {
+     depth = 120;
+     for (r = 0; r < 60; r++) {
+          print "{ let x = 1;";
+          for (i = 0; i < depth; i++) {
+               if (i % 2 == 0) printf "{ let y%d = x; let x = y%d;\n", i, i;
+               else printf "{ let x%d = x; x = x%d;\n", i, i;
+          }
+          print "print x;";
+          for (i = 0; i <= depth; i++) printf "}";
+          print "";
+     }
+}' > "$out/scopes.klx"
+
+# loops nested 24 deep, each resetting a local that its inner loops change
+# the type of. the compiler compiles a loop again when its body changes a
+# type, so this stays fast only while inner loops remember what they lost
+awk 'BEGIN {
+     depth = 24;
+     print "func nest() {";
+     print "     let s = 0; let n = 0; let c0 = 0;";
+     for (i = 0; i < depth; i++) {
+          printf "while (c%d < 1) { c%d = c%d + 1; s = 0;", i, i, i;
+          if (i + 1 < depth) printf " let c%d = 0;", i + 1;
+          print "";
+     }
+     print "n = n + 1;";
+     for (i = 0; i < depth; i++) print "s = \"s\"; }";
+     print "     print n; print s;";
+     print "}";
+     print "nest();";
+}' > "$out/nested_loops.klx"
+
+# one big generated script mixing declarations, blocks and prints
+awk 'BEGIN {
+     print "let total = 0;";
+     print "let name = \"klox\";";
+     print "{";
+     print "     let a = 1; let b = 2; let s = \"x\";";
+     for (i = 0; i < 25000; i++) {
+          print "     { let c = a + b; let d = c * a - b;";
+          print "       total = total + c - d; s = name;";
+          print "       print c == d; }";
+     }
+     print "}";
+     print "print total;";
+}' > "$out/large.klx"
+
+# print-heavy output of numbers, strings and booleans
+awk 'BEGIN {
+     print "{";
+     print "     let a = 0.1; let b = 3; let c = 1234567.25; let s = \"line\";";
+     for (i = 0; i < 20000; i++) {
+          print "     print a; print b; print a * b; print c; print s; print b < a;";
+          print "     a = a + b; c = c / b;";
+     }
+     print "}";
+}' > "$out/print.klx"
+
+# a generated data script made of tens of thousands of numeric literals
+awk 'BEGIN {
+     srand(7);
+     print "let sum = 0;";
+     for (i = 0; i < 20000; i++) {
+          printf "sum = sum + %d.%d - %d + %.6f;\n", int(rand() * 100000),
+                 int(rand() * 1000), int(rand() * 1000), rand();
+     }
+     print "print sum;";
+}' > "$out/numbers.klx"
+
+# many small interprets against one VM, the way the REPL drives it
+awk 'BEGIN {
+     print "let counter = 0;";
+     print "let label = \"count\";";
+     for (i = 0; i < 20000; i++) {
+          print "counter = counter + 1;";
+          if (i % 100 == 0) print "print label + \" is \";";
+     }
+     print "print counter;";
+}' > "$out/repl_lines.repl"
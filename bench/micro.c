@@ -0,0 +1,420 @@
+/*   C-level microbenchmarks for the data structures under the interpreter:
+     the hash table, string interning, the scanner, chunk emission, name
+     resolution in the compiler and compile throughput. this is
+     linked against the same optimized objects as bench/build/klox (everything
+     but main.o), with realloc() wrapped by the linker so every allocation the
+     runtime makes through reallocate() is counted */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chunk.h"
+#include "compiler.h"
+#include "memory.h"
+#include "object.h"
+#include "scanner.h"
+#include "table.h"
+#include "vm.h"
+
+static long allocations = 0;
+
+void* __real_realloc(void* previous, size_t new_size);
+
+void* __wrap_realloc(void* previous, size_t new_size) {
+     allocations++;
+     return __real_realloc(previous, new_size);
+}
+
+typedef struct {
+     double start;
+     long allocations;
+} sample;
+
+static double now_ns() {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static sample begin() {
+     sample s;
+     s.allocations = allocations;
+     s.start = now_ns();
+     return s;
+}
+
+static void report(const char* name, sample s, long ops) {
+     double elapsed = now_ns() - s.start;
+     long allocs = allocations - s.allocations;
+     printf("%-40s %10.2f %12.4f\n", name, elapsed / ops, (double)allocs / ops);
+}
+
+//deterministic xorshift generator so runs are comparable
+static uint32_t rng_state = 2463534242u;
+
+static uint32_t next_random() {
+     rng_state ^= rng_state << 13;
+     rng_state ^= rng_state >> 17;
+     rng_state ^= rng_state << 5;
+     return rng_state;
+}
+
+//sequential keys share long prefixes, random keys are uniformly spread
+static int make_key(char* buffer, int index, bool random) {
+     if (!random) return sprintf(buffer, "key_%d", index);
+
+     int length = 6 + next_random() % 10;
+     for (int i = 0; i < length; i++) {
+          buffer[i] = 'a' + next_random() % 26;
+     }
+     buffer[length] = '\0';
+     return length;
+}
+
+static obj_string** make_keys(int count, bool random) {
+     obj_string** keys = malloc(sizeof(obj_string*) * count);
+     char buffer[32];
+     for (int i = 0; i < count; i++) {
+          int length = make_key(buffer, i, random);
+          keys[i] = copy_string(buffer, length);
+     }
+     return keys;
+}
+
+/*------------------------------- hash table ---------------------------------*/
+
+/*   the table grows by doubling once it is 75% full, so filling it with a
+     fraction of 1024 keys pins its capacity at 1024 and its load factor at
+     that fraction */
+static void bench_table(double load, bool random) {
+     const int capacity = 1024;
+     const int rounds = 2000;
+     int count = (int)(capacity * load);
+     char name[64];
+     const char* dist = random ? "random" : "sequential";
+
+     obj_string** keys = make_keys(count, random);
+     obj_string** missing = make_keys(count, true);
+
+     hash_table table;
+     init_table(&table);
+     for (int i = 0; i < count; i++) table_set(&table, keys[i], NUMBER_VAL(i));
+
+     sample s = begin();
+     for (int r = 0; r < rounds; r++) {
+          for (int i = 0; i < count; i++) {
+               table_set(&table, keys[i], NUMBER_VAL(r));
+          }
+     }
+     snprintf(name, sizeof(name), "table_set   %s load %.2f", dist, load);
+     report(name, s, (long)rounds * count);
+
+     value val;
+     long found = 0;
+     s = begin();
+     for (int r = 0; r < rounds; r++) {
+          for (int i = 0; i < count; i++) {
+               found += table_get(&table, keys[i], &val);
+          }
+     }
+     snprintf(name, sizeof(name), "table_get   %s load %.2f hit", dist, load);
+     report(name, s, (long)rounds * count);
+
+     s = begin();
+     for (int r = 0; r < rounds; r++) {
+          for (int i = 0; i < count; i++) {
+               found += table_get(&table, missing[i], &val);
+          }
+     }
+     snprintf(name, sizeof(name), "table_get   %s load %.2f miss", dist, load);
+     report(name, s, (long)rounds * count);
+
+     //deleting and re-inserting churns through tombstones
+     s = begin();
+     for (int r = 0; r < rounds / 2; r++) {
+          for (int i = 0; i < count; i++) {
+               table_delete(&table, keys[i]);
+               table_set(&table, keys[i], NUMBER_VAL(i));
+          }
+     }
+     snprintf(name, sizeof(name), "table_delete+set %s load %.2f", dist, load);
+     report(name, s, (long)rounds / 2 * count);
+
+     if (found < 0) printf("unreachable\n");
+     free_table(&table);
+     free(keys);
+     free(missing);
+}
+
+/*------------------------------ string interning ----------------------------*/
+
+/*   the inputs are generated up front so only the interning itself is timed,
+     'hit_percent' of them name strings that are already interned */
+static char (*make_inputs(int count, int pool, int hit_percent,
+                          const char* tag))[32] {
+     char (*inputs)[32] = malloc(32 * (size_t)count);
+     for (int i = 0; i < count; i++) {
+          if ((int)(next_random() % 100) < hit_percent) {
+               make_key(inputs[i], next_random() % pool, false);
+          } else {
+               sprintf(inputs[i], "%s_%d_%d", tag, hit_percent, i);
+          }
+     }
+     return inputs;
+}
+
+static void bench_interning(int hit_percent) {
+     const int pool = 4096;
+     const int ops = 400000;
+     char name[64];
+
+     obj_string** keys = make_keys(pool, false);
+     char (*inputs)[32] = make_inputs(ops, pool, hit_percent, "copy");
+
+     sample s = begin();
+     for (int i = 0; i < ops; i++) {
+          copy_string(inputs[i], (int)strlen(inputs[i]));
+     }
+     snprintf(name, sizeof(name), "copy_string %3d%% hits", hit_percent);
+     report(name, s, ops);
+     free(inputs);
+
+     //take_string owns its buffer, so allocating it is part of the operation
+     inputs = make_inputs(ops, pool, hit_percent, "take");
+     s = begin();
+     for (int i = 0; i < ops; i++) {
+          int length = (int)strlen(inputs[i]);
+          char* chars = ALLOCATE(char, length + 1);
+          memcpy(chars, inputs[i], length + 1);
+          take_string(chars, length);
+     }
+     snprintf(name, sizeof(name), "take_string %3d%% hits", hit_percent);
+     report(name, s, ops);
+     free(inputs);
+
+     free(keys);
+}
+
+//what a long concatenation result costs now that it skips the intern table
+static void bench_new_string() {
+     const int ops = 400000;
+     char input[128];
+     memset(input, 'x', sizeof(input) - 1);
+     input[sizeof(input) - 1] = '\0';
+     int length = (int)strlen(input);
+
+     sample s = begin();
+     for (int i = 0; i < ops; i++) {
+          char* chars = ALLOCATE(char, length + 1);
+          memcpy(chars, input, length + 1);
+          new_string(chars, length);
+     }
+     report("new_string 127 chars", s, ops);
+}
+
+/*--------------------------------- scanner ----------------------------------*/
+
+static char* make_source(size_t size) {
+     static const char* pieces[] = {
+          "let ", "total", " = ", "12.5", " + ", "count", " * ", "(", ")",
+          ";\n", "print ", "\"a string literal\"", " == ", "!", "{ ", "} ",
+          "// a comment to skip\n", "while ", "identifier_name", "<= ",
+     };
+     int piece_count = sizeof(pieces) / sizeof(pieces[0]);
+
+     char* source = malloc(size + 64);
+     size_t length = 0;
+     while (length < size) {
+          const char* piece = pieces[next_random() % piece_count];
+          size_t piece_length = strlen(piece);
+          memcpy(source + length, piece, piece_length);
+          length += piece_length;
+     }
+     source[length] = '\0';
+     return source;
+}
+
+static void bench_scanner() {
+     const size_t size = 8 * 1024 * 1024;
+     char* source = make_source(size);
+
+     init_scanner(source);
+     long tokens = 0;
+     sample s = begin();
+     for (;;) {
+          token tok = scan_token();
+          tokens++;
+          if (tok.type == TOKEN_EOF) break;
+     }
+     double elapsed = now_ns() - s.start;
+     report("scan_token", s, tokens);
+     printf("%-40s %10.2f MB/s\n", "scan_token throughput",
+            size / (elapsed / 1e9) / (1024 * 1024));
+
+     free(source);
+}
+
+/*------------------------------ chunk emission ------------------------------*/
+
+static void bench_chunk() {
+     const int chunks = 200;
+     const int bytes = 100000;
+
+     sample s = begin();
+     for (int c = 0; c < chunks; c++) {
+          chunk ch;
+          init_chunk(&ch);
+          for (int i = 0; i < bytes; i++) write_chunk(&ch, (uint8_t)i, i / 8);
+          free_chunk(&ch);
+     }
+     report("write_chunk", s, (long)chunks * bytes);
+
+     s = begin();
+     for (int c = 0; c < chunks; c++) {
+          chunk ch;
+          init_chunk(&ch);
+          for (int i = 0; i < bytes; i++) add_constant(&ch, NUMBER_VAL(i));
+          free_chunk(&ch);
+     }
+     report("add_constant", s, (long)chunks * bytes);
+}
+
+/*------------------------------ name resolution -----------------------------*/
+
+//appends to a growing source buffer
+typedef struct {
+     char* chars;
+     size_t length;
+     size_t capacity;
+} source_buffer;
+
+static void append(source_buffer* buf, const char* format, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void append(source_buffer* buf, const char* format, ...) {
+     va_list args;
+     for (;;) {
+          va_start(args, format);
+          size_t space = buf->capacity - buf->length;
+          int written = vsnprintf(buf->chars + buf->length, space, format, args);
+          va_end(args);
+          if ((size_t)written < space) {
+               buf->length += written;
+               return;
+          }
+          buf->capacity = buf->capacity == 0 ? 4096 : buf->capacity * 2;
+          buf->chars = realloc(buf->chars, buf->capacity);
+     }
+}
+
+/*   functions whose bodies nest 'depth' blocks, each declaring 'width'
+     locals and then reading the outermost ones, so every lookup has the
+     whole list of locals in scope in front of it. with 'globals' each block
+     also reads that many distinct globals. the op counted is one declared
+     or referenced name */
+static char* make_scoped_source(int functions, int depth, int width,
+                                int globals, long* names) {
+     source_buffer buf = { NULL, 0, 0 };
+     *names = 0;
+     for (int f = 0; f < functions; f++) {
+          append(&buf, "func f%d() {\n", f);
+          for (int d = 0; d < depth; d++) {
+               append(&buf, "{\n");
+               for (int w = 0; w < width; w++) {
+                    append(&buf, "let v%d_%d_%d = %d;\n", f, d, w, w);
+               }
+               append(&buf, "v%d_0_0 = v%d_0_1 + v%d_%d_0;\n", f, f, f, d);
+               *names += width + 3;
+               for (int g = 0; g < globals; g++) {
+                    append(&buf, "print g%d_%d;\n", f, (d * globals + g) % 200);
+               }
+               *names += globals;
+          }
+          for (int d = 0; d < depth; d++) append(&buf, "}\n");
+          append(&buf, "}\n");
+     }
+     return buf.chars;
+}
+
+//the script is compiled several times over, its function names are globals
+//and there can only be so many constants in one chunk
+static void bench_resolution(const char* name, int depth, int width,
+                             int globals) {
+     const int functions = 100;
+     const int rounds = 10;
+     long names;
+     char* source = make_scoped_source(functions, depth, width, globals, &names);
+
+     sample s = begin();
+     for (int i = 0; i < rounds; i++) {
+          if (compile(source) == NULL) printf("%s did not compile\n", name);
+     }
+     report(name, s, names * rounds);
+     free(source);
+}
+
+/*------------------------------- compilation --------------------------------*/
+
+/*   a large script made of the same few functions over and over, which all
+     share one global name. it is compiled whole, so this measures the
+     scanner, parser and chunk emission together */
+static void bench_compile() {
+     const size_t size = 32 * 1024 * 1024;
+     const int rounds = 3;
+     source_buffer buf = { NULL, 0, 0 };
+     for (int f = 0; buf.length < size; f++) {
+          append(&buf, "func work(n, step) {\n"
+                       "  let total = %d;\n"
+                       "  let i = 0;\n"
+                       "  while (i < n) {\n"
+                       "    if (i * step > %d.5) total = total + i;\n"
+                       "    else total = total - step * (i + 1);\n"
+                       "    i = i + 1;\n"
+                       "  }\n"
+                       "  return [total, \"label %d\", i];\n"
+                       "}\n", f, f % 97, f % 13);
+     }
+
+     double best = 0;
+     sample s = begin();
+     for (int i = 0; i < rounds; i++) {
+          double start = now_ns();
+          if (compile(buf.chars) == NULL) printf("compile source did not compile\n");
+          double elapsed = now_ns() - start;
+          if (i == 0 || elapsed < best) best = elapsed;
+     }
+     report("compile", s, (long)rounds * buf.length);
+     printf("%-40s %10.2f MB/s\n", "compile throughput",
+            buf.length / (best / 1e9) / (1024 * 1024));
+     free(buf.chars);
+}
+
+int main(int argc, const char* argv[]) {
+     init_vm();
+
+     printf("%-40s %10s %12s\n", "benchmark", "ns/op", "allocs/op");
+
+     double loads[] = { 0.25, 0.5, 0.74 };
+     for (int i = 0; i < 3; i++) {
+          bench_table(loads[i], false);
+          bench_table(loads[i], true);
+     }
+
+     int hits[] = { 100, 90, 50, 0 };
+     for (int i = 0; i < 4; i++) bench_interning(hits[i]);
+     bench_new_string();
+
+     bench_scanner();
+     bench_chunk();
+
+     bench_resolution("resolve 16 locals, 4 scopes", 4, 4, 0);
+     bench_resolution("resolve 250 locals, 50 scopes", 50, 5, 0);
+     bench_resolution("resolve 200 globals per function", 20, 2, 20);
+     bench_compile();
+
+     free_vm();
+     return 0;
+}
@@ -0,0 +1,401 @@
+/*   benchmark harness for klox: runs every workload given on the command line
+     several times in a fresh klox process, reports median and percentile wall
+     times, writes them as JSON and compares them against a saved baseline.
+     with -p it also reads hardware counters for each workload, see
+     run_counters() */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_RUNS     1000
+#define MAX_BENCH    256
+#define MAX_ARGS     16
+
+//what klox --perf-counters reports, in the order of counter_names
+typedef enum {
+     COUNT_CYCLES,
+     COUNT_INSTRUCTIONS,
+     COUNT_BRANCH_MISSES,
+     COUNT_L1D_MISSES,
+     COUNT_LLC_MISSES,
+     COUNT_OPCODES,
+     COUNT_KINDS
+} count_kind;
+
+static const char* counter_names[COUNT_KINDS] = {
+     "cycles", "instructions", "branch-misses", "l1d-misses", "llc-misses",
+     "opcodes"
+};
+
+typedef struct {
+     char name[128];
+     int runs;
+     double min;
+     double median;
+     double p90;
+     double p99;
+     double max;
+     bool failed;
+     double counts[COUNT_KINDS];        //negative for counters not read
+} bench_result;
+
+typedef struct {
+     char name[128];
+     double median;
+} baseline_entry;
+
+static const char* klox = "./klox";
+static const char* klox_args[MAX_ARGS];
+static int klox_arg_count = 0;
+
+static double now_ms() {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static bool has_suffix(const char* str, const char* suffix) {
+     size_t len = strlen(str);
+     size_t suffix_len = strlen(suffix);
+     return len >= suffix_len && strcmp(str + len - suffix_len, suffix) == 0;
+}
+
+static const char* base_name(const char* path) {
+     const char* slash = strrchr(path, '/');
+     return slash == NULL ? path : slash + 1;
+}
+
+/*   runs a single workload once and returns its wall time in milliseconds, or
+     a negative number if klox could not be run or exited with an error.
+     '.repl' workloads are fed line by line to the REPL through stdin, to
+     measure many small interpret() calls against one VM */
+static double run_once(const char* path, const char* const* extra) {
+     bool repl = has_suffix(path, ".repl");
+     double start = now_ms();
+
+     pid_t pid = fork();
+     if (pid < 0) return -1;
+
+     if (pid == 0) {
+          int null_fd = open("/dev/null", O_WRONLY);
+          dup2(null_fd, STDOUT_FILENO);
+          dup2(null_fd, STDERR_FILENO);
+
+          if (repl) {
+               int in_fd = open(path, O_RDONLY);
+               if (in_fd < 0) _exit(127);
+               dup2(in_fd, STDIN_FILENO);
+          }
+
+          const char* argv[MAX_ARGS + 6];
+          int argc = 0;
+          argv[argc++] = klox;
+          for (int i = 0; i < klox_arg_count; i++) argv[argc++] = klox_args[i];
+          while (*extra != NULL) argv[argc++] = *extra++;
+          if (!repl) argv[argc++] = path;
+          argv[argc] = NULL;
+
+          execv(klox, (char* const*)argv);
+          _exit(127);
+     }
+
+     int status;
+     while (waitpid(pid, &status, 0) < 0) {
+          if (errno != EINTR) return -1;
+     }
+
+     double elapsed = now_ms() - start;
+     if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+     return elapsed;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+     double x = *(const double*)a;
+     double y = *(const double*)b;
+     return (x > y) - (x < y);
+}
+
+//nearest-rank percentile over an already sorted sample
+static double percentile(double* sorted, int count, double pct) {
+     int rank = (int)(pct / 100.0 * count + 0.999999);
+     if (rank < 1) rank = 1;
+     if (rank > count) rank = count;
+     return sorted[rank - 1];
+}
+
+static const char* no_args[] = { NULL };
+
+//reads the "name value" lines klox --perf-counters wrote into 'counts'
+static void read_counters(const char* path, double* counts) {
+     FILE* file = fopen(path, "r");
+     if (file == NULL) return;
+
+     char name[64];
+     unsigned long long count;
+     while (fscanf(file, "%63s %llu", name, &count) == 2) {
+          for (int i = 0; i < COUNT_KINDS; i++) {
+               if (strcmp(name, counter_names[i]) == 0) counts[i] = (double)count;
+          }
+     }
+     fclose(file);
+}
+
+/*   one run with klox reading the counters around interpret(), and a traced
+     one for the number of instructions executed, since the counting run has
+     to stay untraced to be worth anything. the counters are read even where
+     they cannot be opened, then they are just missing */
+static void run_counters(const char* path, bench_result* res) {
+     char counts_path[] = "/tmp/klox-counters-XXXXXX";
+     int fd = mkstemp(counts_path);
+     if (fd < 0) return;
+     close(fd);
+
+     char option[64];
+     snprintf(option, sizeof(option), "--perf-counters=%s", counts_path);
+     const char* counting[] = { option, NULL };
+     const char* traced[] = { "--trace", option, NULL };
+
+     double opcodes[COUNT_KINDS];
+     for (int i = 0; i < COUNT_KINDS; i++) opcodes[i] = -1;
+
+     if (run_once(path, counting) >= 0) read_counters(counts_path, res->counts);
+     if (run_once(path, traced) >= 0) read_counters(counts_path, opcodes);
+     res->counts[COUNT_OPCODES] = opcodes[COUNT_OPCODES];
+     unlink(counts_path);
+}
+
+static void run_bench(const char* path, int runs, bool counters,
+                      bench_result* res) {
+     double samples[MAX_RUNS];
+
+     snprintf(res->name, sizeof(res->name), "%s", base_name(path));
+     res->runs = runs;
+     res->failed = false;
+     for (int i = 0; i < COUNT_KINDS; i++) res->counts[i] = -1;
+
+     //one untimed warm-up run so the page cache and the binary are hot
+     if (run_once(path, no_args) < 0) {
+          res->failed = true;
+          return;
+     }
+
+     for (int i = 0; i < runs; i++) {
+          samples[i] = run_once(path, no_args);
+          if (samples[i] < 0) {
+               res->failed = true;
+               return;
+          }
+     }
+
+     qsort(samples, runs, sizeof(double), compare_doubles);
+     res->min = samples[0];
+     res->median = percentile(samples, runs, 50);
+     res->p90 = percentile(samples, runs, 90);
+     res->p99 = percentile(samples, runs, 99);
+     res->max = samples[runs - 1];
+
+     if (counters) run_counters(path, res);
+}
+
+//a ratio of two counts, negative when either of them is missing
+static double ratio(bench_result* res, count_kind a, count_kind b) {
+     if (res->counts[a] < 0 || res->counts[b] <= 0) return -1;
+     return res->counts[a] / res->counts[b];
+}
+
+static void print_ratio(double value) {
+     if (value < 0) {
+          printf(" %11s", "n/a");
+     } else {
+          printf(" %11.4f", value);
+     }
+}
+
+/*   IPC, and the machine instructions and misses per executed bytecode
+     instruction, which is what dispatch and data layout changes move */
+static void print_counters(bench_result* results, int count) {
+     bool any = false;
+     for (int i = 0; i < count; i++) {
+          for (int kind = 0; kind < COUNT_OPCODES; kind++) {
+               if (!results[i].failed && results[i].counts[kind] >= 0) any = true;
+          }
+     }
+     if (!any) {
+          printf("\nhardware counters are unavailable here "
+                 "(perf_event_open failed), skipped\n");
+          return;
+     }
+
+     printf("\n%-28s %11s %11s %11s %11s %11s\n", "counters", "IPC",
+            "instr/op", "br-miss/op", "L1D-miss/op", "LLC-miss/op");
+     for (int i = 0; i < count; i++) {
+          bench_result* res = &results[i];
+          if (res->failed) continue;
+
+          printf("%-28s", res->name);
+          print_ratio(ratio(res, COUNT_INSTRUCTIONS, COUNT_CYCLES));
+          print_ratio(ratio(res, COUNT_INSTRUCTIONS, COUNT_OPCODES));
+          print_ratio(ratio(res, COUNT_BRANCH_MISSES, COUNT_OPCODES));
+          print_ratio(ratio(res, COUNT_L1D_MISSES, COUNT_OPCODES));
+          print_ratio(ratio(res, COUNT_LLC_MISSES, COUNT_OPCODES));
+          printf("\n");
+     }
+}
+
+static void write_json(const char* path, bench_result* results, int count) {
+     FILE* file = fopen(path, "w");
+     if (file == NULL) {
+          fprintf(stderr, "could not write \"%s\".\n", path);
+          exit(74);
+     }
+
+     //one benchmark per line, which is also what read_baseline() relies on
+     fprintf(file, "{\n  \"benchmarks\": [\n");
+     for (int i = 0; i < count; i++) {
+          bench_result* res = &results[i];
+          fprintf(file, "    {\"name\": \"%s\", \"runs\": %d, \"failed\": %s, "
+                  "\"min_ms\": %.3f, \"median_ms\": %.3f, \"p90_ms\": %.3f, "
+                  "\"p99_ms\": %.3f, \"max_ms\": %.3f",
+                  res->name, res->runs, res->failed ? "true" : "false",
+                  res->min, res->median, res->p90, res->p99, res->max);
+
+          //only the counters that were read, named as klox reports them
+          for (int kind = 0; kind < COUNT_KINDS; kind++) {
+               if (res->counts[kind] < 0) continue;
+               fprintf(file, ", \"%s\": %.0f", counter_names[kind],
+                       res->counts[kind]);
+          }
+          fprintf(file, "}%s\n", i + 1 < count ? "," : "");
+     }
+     fprintf(file, "  ]\n}\n");
+     fclose(file);
+}
+
+static int read_baseline(const char* path, baseline_entry* entries) {
+     FILE* file = fopen(path, "r");
+     if (file == NULL) return -1;
+
+     int count = 0;
+     char line[1024];
+     while (count < MAX_BENCH && fgets(line, sizeof(line), file)) {
+          char* name = strstr(line, "\"name\": \"");
+          char* median = strstr(line, "\"median_ms\": ");
+          if (name == NULL || median == NULL) continue;
+
+          name += strlen("\"name\": \"");
+          char* end = strchr(name, '"');
+          if (end == NULL) continue;
+
+          baseline_entry* ent = &entries[count++];
+          snprintf(ent->name, sizeof(ent->name), "%.*s", (int)(end - name), name);
+          ent->median = strtod(median + strlen("\"median_ms\": "), NULL);
+     }
+
+     fclose(file);
+     return count;
+}
+
+static void usage() {
+     fprintf(stderr, "usage: runner [-k klox] [-a klox-arg]... [-n runs] "
+             "[-o out.json] [-b baseline.json] [-t threshold%%] "
+             "[-m slack-ms] [-p] workload...\n");
+     exit(64);
+}
+
+int main(int argc, char* argv[]) {
+     int runs = 10;
+     const char* out_path = NULL;
+     const char* baseline_path = NULL;
+     double threshold = 10.0;
+     double slack = 0.5;
+     bool counters = false;
+
+     int opt;
+     while ((opt = getopt(argc, argv, "k:a:n:o:b:t:m:p")) != -1) {
+          switch (opt) {
+               case 'k': klox = optarg; break;
+               case 'a':
+                    if (klox_arg_count == MAX_ARGS) usage();
+                    klox_args[klox_arg_count++] = optarg;
+                    break;
+               case 'n': runs = atoi(optarg); break;
+               case 'o': out_path = optarg; break;
+               case 'b': baseline_path = optarg[0] ? optarg : NULL; break;
+               case 't': threshold = strtod(optarg, NULL); break;
+               case 'm': slack = strtod(optarg, NULL); break;
+               case 'p': counters = true; break;
+               default: usage();
+          }
+     }
+
+     if (optind == argc || runs < 1 || runs > MAX_RUNS) usage();
+
+     static bench_result results[MAX_BENCH];
+     int count = 0;
+     bool failed = false;
+
+     printf("%-28s %10s %10s %10s %10s\n", "benchmark", "min ms", "median ms",
+            "p90 ms", "p99 ms");
+
+     for (int i = optind; i < argc && count < MAX_BENCH; i++) {
+          //an unmatched shell glob is passed through literally, skip it
+          if (access(argv[i], R_OK) != 0) continue;
+
+          bench_result* res = &results[count++];
+          run_bench(argv[i], runs, counters, res);
+
+          if (res->failed) {
+               printf("%-28s %10s\n", res->name, "FAILED");
+               failed = true;
+               continue;
+          }
+
+          printf("%-28s %10.2f %10.2f %10.2f %10.2f\n", res->name, res->min,
+                 res->median, res->p90, res->p99);
+          fflush(stdout);
+     }
+
+     if (counters) print_counters(results, count);
+     if (out_path != NULL) write_json(out_path, results, count);
+
+     if (baseline_path == NULL) return failed ? 1 : 0;
+
+     static baseline_entry baseline[MAX_BENCH];
+     int baseline_count = read_baseline(baseline_path, baseline);
+     if (baseline_count < 0) {
+          printf("\nno baseline at %s, run 'make bench-baseline' to save one\n",
+                 baseline_path);
+          return failed ? 1 : 0;
+     }
+
+     printf("\n%-28s %10s %10s %9s\n", "vs baseline", "base ms", "now ms",
+            "change");
+
+     for (int i = 0; i < count; i++) {
+          bench_result* res = &results[i];
+          if (res->failed) continue;
+
+          for (int j = 0; j < baseline_count; j++) {
+               if (strcmp(res->name, baseline[j].name) != 0) continue;
+
+               double base = baseline[j].median;
+               double change = base > 0 ? (res->median - base) / base * 100 : 0;
+               bool regressed = res->median > base * (1 + threshold / 100) &&
+                                res->median - base > slack;
+
+               printf("%-28s %10.2f %10.2f %+8.1f%%%s\n", res->name, base,
+                      res->median, change, regressed ? "  REGRESSION" : "");
+               if (regressed) failed = true;
+               break;
+          }
+     }
+
+     return failed ? 1 : 0;
+}
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "chunk.h"
 #include "memory.h"
@@ -9,16 +10,39 @@ void init_chunk(chunk* chunk) {
      chunk->code = NULL;
      chunk->lines = NULL;
      init_val_array(&chunk->constants);
+     chunk->arenas = NULL;
+}
+
+/*   an array of an arena-backed chunk stays in its arena until that is
+     full, then carries on in the heap like any other */
+static void* grow(arena* a, void* array, size_t old_size, size_t new_size) {
+     if (a != NULL && (array == NULL || arena_owns(a, array))) {
+          void* grown = arena_grow(a, array, old_size, new_size);
+          if (grown != NULL) return grown;
+
+          grown = reallocate(NULL, 0, new_size);
+          if (old_size > 0) memcpy(grown, array, old_size);
+          return grown;
+     }
+     return reallocate(array, old_size, new_size);
 }
 
 void write_chunk(chunk* chunk, uint8_t byte, int line) {
      if (chunk->capacity < chunk->count + 1) {
           int old_capacity = chunk->capacity;
           chunk->capacity = GROW_CAPACITY(old_capacity);
-          chunk->code = GROW_ARRAY(chunk->code, uint8_t,
-                                   old_capacity, chunk->capacity);
-          chunk->lines = GROW_ARRAY(chunk->lines, int,
-                                   old_capacity, chunk->capacity);
+          if (chunk->arenas != NULL) {
+               chunk->code = grow(&chunk->arenas->code, chunk->code,
+                                  old_capacity, chunk->capacity);
+               chunk->lines = grow(&chunk->arenas->lines, chunk->lines,
+                                   sizeof(int) * old_capacity,
+                                   sizeof(int) * chunk->capacity);
+          } else {
+               chunk->code = GROW_ARRAY(chunk->code, uint8_t,
+                                        old_capacity, chunk->capacity);
+               chunk->lines = GROW_ARRAY(chunk->lines, int,
+                                        old_capacity, chunk->capacity);
+          }
      }
 
      chunk->code[chunk->count] = byte;
@@ -31,10 +55,47 @@ int add_constant(chunk* chunk, value val) {
      /*   this function adds the given value to the constant pool
           and returns the index of the added constant for later use   */
 
-     write_val_array(&chunk->constants, val);
+     val_array* constants = &chunk->constants;
+     if (chunk->arenas != NULL && constants->capacity < constants->count + 1) {
+          int old_capacity = constants->capacity;
+          constants->capacity = GROW_CAPACITY(old_capacity);
+          constants->values = grow(&chunk->arenas->constants, constants->values,
+                                   sizeof(value) * old_capacity,
+                                   sizeof(value) * constants->capacity);
+     }
+
+     write_val_array(constants, val);
      return chunk->constants.count - 1;
 }
 
+//copies an arena array to the heap, or trims one already there
+static void* compact(arena* a, void* array, size_t capacity, size_t count) {
+     if (!arena_owns(a, array)) return reallocate(array, capacity, count);
+     if (count == 0) return NULL;
+
+     void* compacted = reallocate(NULL, 0, count);
+     memcpy(compacted, array, count);
+     return compacted;
+}
+
+void compact_chunk(chunk* chunk) {
+     chunk_arenas* arenas = chunk->arenas;
+     if (arenas == NULL) return;
+
+     int count = chunk->count;
+     int constant_count = chunk->constants.count;
+     chunk->code = compact(&arenas->code, chunk->code, chunk->capacity, count);
+     chunk->lines = compact(&arenas->lines, chunk->lines,
+                            sizeof(int) * chunk->capacity, sizeof(int) * count);
+     chunk->constants.values = compact(&arenas->constants,
+                                       chunk->constants.values,
+                                       sizeof(value) * chunk->constants.capacity,
+                                       sizeof(value) * constant_count);
+     chunk->capacity = count;
+     chunk->constants.capacity = constant_count;
+     chunk->arenas = NULL;
+}
+
 void free_chunk(chunk* chunk) {
      FREE_ARRAY(uint8_t, chunk->code, chunk->capacity);
      FREE_ARRAY(int, chunk->lines, chunk->capacity);
@@ -1,11 +1,13 @@
 #ifndef klox_chunk_h
 #define klox_chunk_h
 
+#include "arena.h"
 #include "common.h"
 #include "value.h"
 
 typedef enum {
      OP_CONSTANT,
+     OP_CONSTANT_LONG,
      OP_NULL,
      OP_TRUE,
      OP_FALSE,
@@ -24,10 +26,43 @@ typedef enum {
      OP_DIVIDE,
      OP_NOT,
      OP_NEGATE,
+     OP_CONCAT,               //a chain of n additions, n in the operand
+     //variants of the above for operands whose types the compiler proved
+     OP_ADD_NUM,
+     OP_ADD_STR,
+     OP_SUBTRACT_NUM,
+     OP_MULTIPLY_NUM,
+     OP_DIVIDE_NUM,
+     OP_GREATER_NUM,
+     OP_LESS_NUM,
+     OP_NOT_BOOL,
+     OP_NEGATE_NUM,
      OP_PRINT,
+     OP_BUILD_ARRAY,
+     OP_INDEX_GET,
+     OP_INDEX_SET,
+     OP_CALL,
+     OP_TAIL_CALL,
+     OP_JUMP,
+     OP_JUMP_IF_FALSE,
+     OP_LOOP,
+     OP_JUMP_IF_LOCAL_NOT_LESS,
+     OP_INCREMENT_LOCAL_LOOP,
+     OP_COUNT,                //only emitted with coverage enabled
      OP_RETURN,
 } opcode;
 
+//largest constant index OP_CONSTANT_LONG's 24-bit operand can address
+#define CONSTANT_LONG_MAX 0xffffff
+
+/*   where the compiler emits chunks: each array of a chunk being written is
+     the newest block of its arena, so it grows without being copied */
+typedef struct {
+     arena code;
+     arena lines;
+     arena constants;
+} chunk_arenas;
+
 //chunk represents a block of bytecode
 typedef struct {
      int count;
@@ -35,12 +70,17 @@ typedef struct {
      uint8_t* code;
      int* lines;
      val_array constants;
+     chunk_arenas* arenas;    //NULL once the chunk lives on the heap
 } chunk;
 
 
 void init_chunk(chunk* chunk);
 void write_chunk(chunk* chunk, uint8_t byte, int line);
 int add_constant(chunk* chunk, value val);
+
+/*   moves a chunk written in arenas to heap arrays of exactly its size,
+     after which the arenas can be released */
+void compact_chunk(chunk* chunk);
 void free_chunk(chunk* chunk);
 
 #endif
@@ -5,8 +5,14 @@
 #include <stddef.h>
 #include <stdint.h>
 
+//release builds (such as the benchmark build) compile with -DNDEBUG
+#ifndef NDEBUG
 #define DEBUG_PRINT_CODE
 #define DEBUG_TRACE_EXECUTION
+#endif
+
+/*   -DKLOX_COMPACT_HEAP puts every object in one reserved region with a
+     4-byte header and strings stored inline, see object.h */
 
 #define UINT8_COUNT (UINT8_MAX + 1)
 
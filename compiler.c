@@ -4,6 +4,9 @@
 
 #include "common.h"
 #include "compiler.h"
+#include "coverage.h"
+#include "memory.h"
+#include "number.h"
 #include "scanner.h"
 
 #ifdef DEBUG_PRINT_CODE
@@ -39,26 +42,149 @@ typedef struct {
      precedence prec;
 } parse_rule;
 
+/*   what the compiler knows about the value an expression or a local holds
+     at some point of the program. it is only ever a fact about every value
+     that can reach that point, so a checked opcode can be replaced with an
+     unchecked one whenever the facts about its operands satisfy its check */
+typedef enum {
+     KNOWN_NOTHING,
+     KNOWN_NUMBER,
+     KNOWN_STRING,
+     KNOWN_BOOL
+} static_type;
+
+struct s_compiler;
+
+/*   an identifier, interned once per compile() so that names are compared
+     by pointer from then on. it also records which local the name currently
+     resolves to: a local of 'owner', the compiler of the function that
+     declared it, or nothing when 'owner' is NULL */
+typedef struct {
+     const char* start;       //the lexeme, inside the source being compiled
+     int length;
+     uint32_t hash;
+     obj_string* string;      //the name as a string constant, made on first use
+     struct s_compiler* owner;
+     int slot;
+} symbol;
+
+//the hash is kept beside the pointer so a probe rarely has to follow it
+typedef struct {
+     uint32_t hash;
+     symbol* sym;
+} symbol_entry;
+
+//symbols are handed out from blocks, a few hundred to an allocation
+#define SYMBOL_BLOCK 256
+
+typedef struct s_symbol_block {
+     struct s_symbol_block* next;
+     int count;
+     symbol symbols[SYMBOL_BLOCK];
+} symbol_block;
+
+//open addressing, the capacity is a power of two
+typedef struct {
+     int count;
+     int capacity;
+     symbol_entry* entries;
+     symbol_block* blocks;
+} symbol_table;
+
 typedef struct {
-    token name;
+    symbol* name;            //NULL for the callee's slot
     int depth;
+    static_type type;        //what every value the local holds here is
+    struct s_compiler* shadowed_owner; //the binding of 'name' this one hides
+    int shadowed_slot;
 } local;
 
+//bytecode lifted out of the chunk to be emitted again somewhere else
+typedef struct {
+     int count;
+     uint8_t* code;
+     int* lines;
+} code_fragment;
+
+//how control leaves a loop whose condition is false
 typedef struct {
+     int exit_jump;           //operand of the jump out of the loop
+     bool fused;              //condition became an OP_JUMP_IF_LOCAL_NOT_LESS
+     uint8_t slot;            //for a fused condition, the local compared
+     uint8_t limit;           //and the constant it is compared against
+} loop_exit;
+
+typedef enum {
+     TYPE_FUNCTION,
+     TYPE_SCRIPT
+} function_type;
+
+//one compiler per function being compiled, linked to the enclosing one
+typedef struct s_compiler {
+    struct s_compiler* enclosing;
+    obj_function* function;
+    function_type type;
+
     local locals[UINT8_COUNT];
     int local_count;
     int scope_depth;
+    hash_table strings;      //string constant -> its first index in the chunk
+    size_t marks[3];         //how full the chunk arenas were when it started
+    int last_call;           //offset of the most recent OP_CALL, or -1
+    static_type expr_type;   //type of the expression compiled last
 } compiler;
 
+//the local types at one point of the program, for merging control flow
+typedef struct {
+     int count;
+     static_type types[UINT8_COUNT];
+} type_state;
+
+/*   where a loop starts. the body is compiled assuming the local types at
+     the loop head, and compiled again from here when the body turns out to
+     change one of them */
+typedef struct {
+     const char* at;          //the token before the loop, names it in 'loops'
+     scanner scan;
+     token current;
+     token previous;
+     int code_count;
+     int constant_count;
+     type_state types;        //what the body may assume at the loop head
+     bool forget[UINT8_COUNT];//locals a for loop increment may assume nothing of
+} loop_head;
+
+/*   a fact a loop was found not to keep. a loop inside another one is
+     compiled again every time the outer one is, and starts out without the
+     facts it already lost, so it does not have to retry to lose them again */
+typedef struct {
+     const char* at;
+     uint8_t slot;
+     bool step;               //only lost by a for loop's increment
+} lost_fact;
+
+typedef struct {
+     int depth;               //loops being compiled, across functions
+     int count;
+     int capacity;
+     lost_fact* facts;
+} loop_memory;
+
 parser parse;
 
 compiler* current = NULL;
 
-//the chunk that we are currently compiling to
-chunk* compiling;
+static symbol_table symbols;
+
+//forgotten when the outermost loop is done, nothing can compile it again
+static loop_memory loops;
 
+//every function's chunk is written here and copied out when it is done
+static chunk_arenas arenas;
+
+//the chunk of the function that we are currently compiling
 static chunk* current_chunk() {
-     return compiling;
+     return &current->function->chunk;
 }
 
 /*------------------------ error reporting functions -------------------------*/
@@ -131,6 +257,7 @@ static void emit_byte(uint8_t byte){
 }
 
 static void emit_return() {
+     emit_byte(OP_NULL);
      emit_byte(OP_RETURN);
 }
 
@@ -150,23 +277,241 @@ static void emit_bytes(uint8_t byte1, uint8_t byte2) {
      emit_byte(byte2);
 }
 
+/*   values pushed by OP_CONSTANT are not limited to the 256 slots a one byte
+     operand can address, past that they use a 24-bit operand instead */
 static void emit_constant(value val) {
-     emit_bytes(OP_CONSTANT, make_constant(val));
+     int constant = add_constant(current_chunk(), val);
+     if (constant <= UINT8_MAX) {
+          emit_bytes(OP_CONSTANT, (uint8_t)constant);
+          return;
+     }
+
+     if (constant > CONSTANT_LONG_MAX) {
+          error("too many constants in one chunk");
+          return;
+     }
+
+     emit_byte(OP_CONSTANT_LONG);
+     emit_byte((uint8_t)(constant & 0xff));
+     emit_byte((uint8_t)((constant >> 8) & 0xff));
+     emit_byte((uint8_t)((constant >> 16) & 0xff));
 }
 
-static void init_compiler(compiler* c) {
+//emits a jump with a placeholder offset and returns where that offset is
+static int emit_jump(uint8_t instruction) {
+     emit_byte(instruction);
+     emit_byte(0xff);
+     emit_byte(0xff);
+     return current_chunk()->count - 2;
+}
+
+//points the jump at 'offset' to the next instruction to be emitted
+static void patch_jump(int offset) {
+     //-2 to skip over the jump offset itself
+     int jump = current_chunk()->count - offset - 2;
+
+     if (jump > UINT16_MAX) {
+          error("too much code to jump over");
+     }
+
+     current_chunk()->code[offset] = (jump >> 8) & 0xff;
+     current_chunk()->code[offset + 1] = jump & 0xff;
+}
+
+static void emit_loop(int loop_start) {
+     emit_byte(OP_LOOP);
+
+     //+2 to also jump back over the loop offset
+     int offset = current_chunk()->count - loop_start + 2;
+     if (offset > UINT16_MAX) error("loop body too large");
+
+     emit_byte((offset >> 8) & 0xff);
+     emit_byte(offset & 0xff);
+}
+
+//moves everything emitted since 'start' out of the chunk into 'fragment'
+static void cut_code(int start, code_fragment* fragment) {
+     chunk* ch = current_chunk();
+     fragment->count = ch->count - start;
+     fragment->code = ALLOCATE(uint8_t, fragment->count);
+     fragment->lines = ALLOCATE(int, fragment->count);
+     memcpy(fragment->code, ch->code + start, fragment->count);
+     memcpy(fragment->lines, ch->lines + start, sizeof(int) * fragment->count);
+     ch->count = start;
+}
+
+static void paste_code(code_fragment* fragment) {
+     for (int i = 0; i < fragment->count; i++) {
+          write_chunk(current_chunk(), fragment->code[i], fragment->lines[i]);
+     }
+}
+
+static void free_code(code_fragment* fragment) {
+     FREE_ARRAY(uint8_t, fragment->code, fragment->count);
+     FREE_ARRAY(int, fragment->lines, fragment->count);
+     fragment->count = 0;
+}
+
+static void init_compiler(compiler* c, function_type type) {
+    c->enclosing = current;
+    c->function = NULL;
+    c->type = type;
     c->local_count = 0;
     c->scope_depth = 0;
+    c->last_call = -1;
+    c->expr_type = KNOWN_NOTHING;
+    c->function = new_function();
+    c->function->chunk.arenas = &arenas;
+    c->marks[0] = arena_mark(&arenas.code);
+    c->marks[1] = arena_mark(&arenas.lines);
+    c->marks[2] = arena_mark(&arenas.constants);
+    init_table(&c->strings);
     current = c;
+
+    if (type != TYPE_SCRIPT) {
+         current->function->name = copy_string(parse.previous.start,
+                                               parse.previous.length);
+    }
+
+    //slot 0 holds the function being called, it has no name to resolve
+    local* loc = &current->locals[current->local_count++];
+    loc->depth = 0;
+    loc->type = KNOWN_NOTHING;
+    loc->name = NULL;
+}
+
+/*------------------------------- symbol table -------------------------------*/
+
+static uint32_t hash_lexeme(const char* start, int length) {
+     uint32_t hash = 2166136261u;
+     for (int i = 0; i < length; i++) {
+          hash ^= (uint8_t)start[i];
+          hash *= 16777619;
+     }
+     return hash;
+}
+
+static symbol_entry* find_symbol(symbol_entry* entries, int capacity,
+                                 const char* start, int length, uint32_t hash) {
+     uint32_t index = hash & (capacity - 1);
+     for (;;) {
+          symbol_entry* ent = &entries[index];
+          if (ent->sym == NULL ||
+              (ent->hash == hash && ent->sym->length == length &&
+               memcmp(ent->sym->start, start, length) == 0)) {
+               return ent;
+          }
+          index = (index + 1) & (capacity - 1);
+     }
+}
+
+static void grow_symbols() {
+     int capacity = symbols.capacity < 256 ? 256 : symbols.capacity * 2;
+     symbol_entry* entries = ALLOCATE(symbol_entry, capacity);
+     memset(entries, 0, sizeof(symbol_entry) * capacity);
+
+     for (int i = 0; i < symbols.capacity; i++) {
+          symbol_entry* ent = &symbols.entries[i];
+          if (ent->sym == NULL) continue;
+          *find_symbol(entries, capacity, ent->sym->start, ent->sym->length,
+                       ent->hash) = *ent;
+     }
+
+     FREE_ARRAY(symbol_entry, symbols.entries, symbols.capacity);
+     symbols.entries = entries;
+     symbols.capacity = capacity;
+}
+
+static symbol* new_symbol() {
+     symbol_block* block = symbols.blocks;
+     if (block == NULL || block->count == SYMBOL_BLOCK) {
+          block = ALLOCATE(symbol_block, 1);
+          block->next = symbols.blocks;
+          block->count = 0;
+          symbols.blocks = block;
+     }
+     return &block->symbols[block->count++];
+}
+
+static symbol* intern_name(token* name) {
+     //kept at most half full, so misses end quickly
+     if (symbols.count + 1 > symbols.capacity / 2) grow_symbols();
+
+     uint32_t hash = hash_lexeme(name->start, name->length);
+     symbol_entry* ent = find_symbol(symbols.entries, symbols.capacity,
+                                     name->start, name->length, hash);
+     if (ent->sym != NULL) return ent->sym;
+
+     symbol* sym = new_symbol();
+     sym->start = name->start;
+     sym->length = name->length;
+     sym->hash = hash;
+     sym->string = NULL;
+     sym->owner = NULL;
+     sym->slot = -1;
+     ent->hash = hash;
+     ent->sym = sym;
+     symbols.count++;
+     return sym;
+}
+
+/*   between top-level declarations no name is bound to a local, so the
+     symbols can all be forgotten. doing so once there are many keeps the
+     table small enough to stay in cache */
+static void forget_symbols() {
+     if (symbols.count < SYMBOL_BLOCK * 4) return;
+
+     while (symbols.blocks->next != NULL) {
+          symbol_block* next = symbols.blocks->next;
+          FREE(symbol_block, symbols.blocks);
+          symbols.blocks = next;
+     }
+     symbols.blocks->count = 0;
+     memset(symbols.entries, 0, sizeof(symbol_entry) * symbols.capacity);
+     symbols.count = 0;
+}
+
+static void free_symbols() {
+     while (symbols.blocks != NULL) {
+          symbol_block* next = symbols.blocks->next;
+          FREE(symbol_block, symbols.blocks);
+          symbols.blocks = next;
+     }
+     FREE_ARRAY(symbol_entry, symbols.entries, symbols.capacity);
+     symbols.count = 0;
+     symbols.capacity = 0;
+     symbols.entries = NULL;
+}
+
+//the local leaving scope makes the binding it hid visible again
+static void pop_local() {
+     local* loc = &current->locals[--current->local_count];
+     loc->name->owner = loc->shadowed_owner;
+     loc->name->slot = loc->shadowed_slot;
 }
 
-static void end_compiler() {
+static obj_function* end_compiler() {
      emit_return();
+     obj_function* function = current->function;
+
 #ifdef DEBUG_PRINT_CODE
      if (!parse.had_error) {
-          disassemble_chunk(current_chunk(), "code");
+          disassemble_chunk(current_chunk(), function->name != NULL
+               ? function->name->chars : "<script>");
      }
 #endif
+
+     //parameters and the outermost locals are never popped by end_scope()
+     while (current->local_count > 1) pop_local();
+     free_table(&current->strings);
+
+     //the functions nested in this one are done, so its arrays are the newest
+     compact_chunk(current_chunk());
+     arena_release(&arenas.code, current->marks[0]);
+     arena_release(&arenas.lines, current->marks[1]);
+     arena_release(&arenas.constants, current->marks[2]);
+     current = current->enclosing;
+     return function;
 }
 
 static void begin_scope() {
@@ -180,10 +525,118 @@ static void end_scope() {
             current->locals[current->local_count - 1].depth >
             current->scope_depth) {
                 emit_byte(OP_POP);
-                current->local_count--;
+                pop_local();
      }
 }
 
+/*--------------------------- static type tracking ---------------------------*/
+
+static void save_types(type_state* state) {
+     state->count = current->local_count;
+     for (int i = 0; i < state->count; i++) {
+          state->types[i] = current->locals[i].type;
+     }
+}
+
+static void restore_types(type_state* state) {
+     for (int i = 0; i < state->count; i++) {
+          current->locals[i].type = state->types[i];
+     }
+}
+
+//where two paths join, only the facts that hold on both of them survive
+static void merge_types(type_state* other) {
+     for (int i = 0; i < other->count; i++) {
+          if (current->locals[i].type != other->types[i]) {
+               current->locals[i].type = KNOWN_NOTHING;
+          }
+     }
+}
+
+static void lose_fact(loop_head* head, int slot, bool step) {
+     if (loops.count == loops.capacity) {
+          int old_capacity = loops.capacity;
+          loops.capacity = GROW_CAPACITY(old_capacity);
+          loops.facts = GROW_ARRAY(loops.facts, lost_fact, old_capacity,
+                                   loops.capacity);
+     }
+     lost_fact* fact = &loops.facts[loops.count++];
+     fact->at = head->at;
+     fact->slot = (uint8_t)slot;
+     fact->step = step;
+}
+
+//the increment of a for loop may not assume anything of 'slot'
+static void forget_step(loop_head* head, int slot) {
+     head->forget[slot] = true;
+     lose_fact(head, slot, true);
+}
+
+static void free_loops() {
+     FREE_ARRAY(lost_fact, loops.facts, loops.capacity);
+     loops.depth = 0;
+     loops.count = 0;
+     loops.capacity = 0;
+     loops.facts = NULL;
+}
+
+static void begin_loop(loop_head* head) {
+     head->at = parse.previous.start;
+     head->scan = save_scanner();
+     head->current = parse.current;
+     head->previous = parse.previous;
+     head->code_count = current_chunk()->count;
+     head->constant_count = current_chunk()->constants.count;
+     memset(head->forget, 0, sizeof(head->forget));
+
+     for (int i = 0; i < loops.count; i++) {
+          lost_fact* fact = &loops.facts[i];
+          if (fact->at != head->at || fact->slot >= current->local_count) {
+               continue;
+          }
+          if (fact->step) {
+               head->forget[fact->slot] = true;
+          } else {
+               current->locals[fact->slot].type = KNOWN_NOTHING;
+          }
+     }
+     save_types(&head->types);
+     loops.depth++;
+}
+
+/*   checks the local types flowing back to the loop head against the ones the
+     loop was compiled assuming. if they disagree, the facts that did not
+     hold are dropped and the compiler is rewound to the loop head, and the
+     caller compiles the loop again. every retry drops a fact, and a dropped
+     fact stays dropped when an enclosing loop compiles this one again, so a
+     loop is compiled at most once more than the loop around it plus once for
+     each fact it loses */
+static bool end_loop(loop_head* head, type_state* back, bool stable) {
+     if (!parse.had_error) {
+          for (int i = 0; i < head->types.count; i++) {
+               if (head->types.types[i] != KNOWN_NOTHING &&
+                   head->types.types[i] != back->types[i]) {
+                    head->types.types[i] = KNOWN_NOTHING;
+                    lose_fact(head, i, false);
+                    stable = false;
+               }
+          }
+
+          if (!stable) {
+               restore_scanner(head->scan);
+               parse.current = head->current;
+               parse.previous = head->previous;
+               current_chunk()->count = head->code_count;
+               current_chunk()->constants.count = head->constant_count;
+               restore_types(&head->types);
+               return false;
+          }
+     }
+
+     if (--loops.depth == 0) loops.count = 0;
+     return true;
+}
+
 /*-------------------------- more parsing functions --------------------------*/
 
 static void expression();
@@ -192,30 +645,53 @@ static void declaration();
 static parse_rule* get_rule(token_type type);
 static void parse_prec(precedence prec);
 
-static uint8_t identifier_constant(token* name) {
-     return make_constant(OBJ_VAL(copy_string(name->start, name->length)));
+/*   the first constant in the chunk holding 'string', or -1. a loop that is
+     compiled again drops the constants it added, so an index from the table
+     only counts while the chunk still has that string there */
+static int find_string_constant(obj_string* string) {
+     value index;
+     if (!table_get(&current->strings, string, &index)) return -1;
+
+     val_array* constants = &current_chunk()->constants;
+     int i = (int)AS_INT(index);
+     if (i < constants->count && IS_STRING(constants->values[i]) &&
+         AS_STRING(constants->values[i]) == string) {
+          return i;
+     }
+     return -1;
 }
 
-static bool identifiers_equal(token* a, token* b) {
-       if (a->length != b->length) return false;
-       return memcmp(a->start, b->start, a->length) == 0;
+static void remember_string_constant(obj_string* string, int index) {
+     if (index <= UINT8_MAX && find_string_constant(string) == -1) {
+          table_set(&current->strings, string, INT_VAL(index));
+     }
 }
 
-static int resolve_local(compiler* c, token* name) {
-     for (int i = c->local_count - 1; i >= 0; i--) {
-          local* loc = &c->locals[i];
-          if (identifiers_equal(name, &loc->name)) {
-               if (loc->depth == -1) {
-                    error("cannot read local variable in its own initializer");
-               }
-               return i;
-          }
+//a global is referred to by a constant holding its name, shared by every use
+static uint8_t identifier_constant(symbol* name) {
+     if (name->string == NULL) {
+          name->string = copy_string(name->start, name->length);
      }
 
-     return -1;
+     int index = find_string_constant(name->string);
+     if (index != -1 && index <= UINT8_MAX) return (uint8_t)index;
+
+     uint8_t constant = make_constant(OBJ_VAL(name->string));
+     remember_string_constant(name->string, current_chunk()->constants.count - 1);
+     return constant;
 }
 
-static void add_local(token name) {
+//only the locals of the function being compiled are visible
+static int resolve_local(compiler* c, symbol* name) {
+     if (name->owner != c) return -1;
+
+     if (c->locals[name->slot].depth == -1) {
+          error("cannot read local variable in its own initializer");
+     }
+     return name->slot;
+}
+
+static void add_local(symbol* name) {
      if (current->local_count == UINT8_COUNT) {
           error("too many local variables in block");
           return;
@@ -223,57 +699,238 @@ static void add_local(token name) {
      local* loc = &current->locals[current->local_count++];
      loc->name = name;
      loc->depth = -1;
+     loc->type = KNOWN_NOTHING;
+
+     loc->shadowed_owner = name->owner;
+     loc->shadowed_slot = name->slot;
+     name->owner = current;
+     name->slot = current->local_count - 1;
 }
 
 static void declare_variable() {
      //globals are implicitly declared
      if (current->scope_depth == 0) return;
-     token* name = &parse.previous;
+     symbol* name = intern_name(&parse.previous);
 
-     for (int i = current->local_count - 1; i >= 0; i--) {
-          local* loc = &current->locals[i];
-          if (loc->depth != -1 && loc->depth < current->scope_depth) {
-               break;
+     //the innermost local with this name, declared in this very scope
+     if (name->owner == current) {
+          local* loc = &current->locals[name->slot];
+          if (loc->depth == -1 || loc->depth >= current->scope_depth) {
+               error("a variable with this name already exists in this scope");
           }
+     }
 
-          if (identifiers_equal(name, &loc->name)) {
-               error("a variable with this name already exists in this scope");
+     add_local(name);
+}
+
+//the right operand of and/or may not run, so its facts are merged back
+static void logical_operand(precedence prec) {
+     static_type left = current->expr_type;
+     type_state skipped;
+     save_types(&skipped);
+
+     parse_prec(prec);
+
+     merge_types(&skipped);
+     if (current->expr_type != left) current->expr_type = KNOWN_NOTHING;
+}
+
+static void and_(bool can_assign) {
+     int end_jump = emit_jump(OP_JUMP_IF_FALSE);
+
+     emit_byte(OP_POP);
+     logical_operand(PREC_AND);
+
+     patch_jump(end_jump);
+}
+
+static void or_(bool can_assign) {
+     int else_jump = emit_jump(OP_JUMP_IF_FALSE);
+     int end_jump = emit_jump(OP_JUMP);
+
+     patch_jump(else_jump);
+     emit_byte(OP_POP);
+
+     logical_operand(PREC_OR);
+     patch_jump(end_jump);
+}
+
+static uint8_t argument_list() {
+     uint8_t arg_count = 0;
+     if (!check(TOKEN_RIGHT_PAREN)) {
+          do {
+               expression();
+               if (arg_count == 255) {
+                    error("cannot have more than 255 arguments");
+               }
+               arg_count++;
+          } while (match(TOKEN_COMMA));
+     }
+
+     consume(TOKEN_RIGHT_PAREN, "expected ')' after arguments");
+     return arg_count;
+}
+
+static void call(bool can_assign) {
+     uint8_t arg_count = argument_list();
+     current->last_call = current_chunk()->count;
+     emit_bytes(OP_CALL, arg_count);
+     current->expr_type = KNOWN_NOTHING;
+}
+
+//the elements are left on the stack and collected by OP_BUILD_ARRAY
+static void array(bool can_assign) {
+     int count = 0;
+     if (!check(TOKEN_RIGHT_BRACKET)) {
+          do {
+               expression();
+               if (count == 255) {
+                    error("cannot have more than 255 elements in an array literal");
+               }
+               count++;
+          } while (match(TOKEN_COMMA));
+     }
+
+     consume(TOKEN_RIGHT_BRACKET, "expected ']' after array elements");
+     emit_bytes(OP_BUILD_ARRAY, (uint8_t)count);
+     current->expr_type = KNOWN_NOTHING;
+}
+
+static void subscript(bool can_assign) {
+     expression();
+     consume(TOKEN_RIGHT_BRACKET, "expected ']' after index");
+
+     if (can_assign && match(TOKEN_EQUAL)) {
+          //the assignment evaluates to the assigned value and its type
+          expression();
+          emit_byte(OP_INDEX_SET);
+     } else {
+          emit_byte(OP_INDEX_GET);
+          current->expr_type = KNOWN_NOTHING;
+     }
+}
+
+//the type an addition leaves, given what is known about its operands
+static static_type addition_type(static_type a, static_type b) {
+     //a checked addition only succeeds on two numbers or two strings
+     if (a == KNOWN_NUMBER || b == KNOWN_NUMBER) return KNOWN_NUMBER;
+     if (a == KNOWN_STRING || b == KNOWN_STRING) return KNOWN_STRING;
+     return KNOWN_NOTHING;
+}
+
+/*   whether the operand after the '+' the parser is looking at is a literal
+     or a local on its own. those can neither fail nor have side effects, so
+     evaluating one before an addition that fails changes nothing */
+static bool plain_operand_follows() {
+     scanner saved = save_scanner();
+     token operand = scan_token();
+     token after = scan_token();
+     restore_scanner(saved);
+
+     if (get_rule(after.type)->prec > PREC_TERM) return false;
+     switch (operand.type) {
+          case TOKEN_STRING:
+          case TOKEN_NUMBER:
+               return true;
+          case TOKEN_IDENTIFIER: {
+               symbol* sym = intern_name(&operand);
+               return sym->owner == current &&
+                      current->locals[sym->slot].depth != -1;
           }
+          default:
+               return false;
+     }
+}
+
+/*   a + b + c ... with the first two operands compiled already. when one of
+     them is a string the chain becomes one OP_CONCAT, which joins them all
+     with a single allocation. numbers keep their OP_ADDs, which the JIT
+     inlines. once an addition in the chain might fail only plain operands
+     are taken in, so errors come where one OP_ADD per '+' would raise them */
+static void addition(static_type left, static_type right) {
+     if (left == KNOWN_NUMBER && right == KNOWN_NUMBER) {
+          emit_byte(OP_ADD_NUM);
+          current->expr_type = KNOWN_NUMBER;
+          return;
      }
 
-     add_local(*name);
+     bool strings = left == KNOWN_STRING && right == KNOWN_STRING;
+     static_type type = addition_type(left, right);
+     int count = 2;
+     while (type == KNOWN_STRING && parse.current.type == TOKEN_PLUS &&
+            count < UINT8_MAX && (strings || plain_operand_follows())) {
+          advance();
+          parse_prec(PREC_FACTOR);
+          strings = strings && current->expr_type == KNOWN_STRING;
+          type = addition_type(type, current->expr_type);
+          count++;
+     }
+
+     if (count > 2) {
+          emit_bytes(OP_CONCAT, (uint8_t)count);
+     } else {
+          emit_byte(strings ? OP_ADD_STR : OP_ADD);
+     }
+     current->expr_type = type;
 }
 
 static void binary(bool can_assign) {
      token_type operator = parse.previous.type;
+     static_type left = current->expr_type;
 
      parse_rule* rule = get_rule(operator);
      parse_prec((precedence)(rule->prec + 1));
 
+     static_type right = current->expr_type;
+     bool numbers = left == KNOWN_NUMBER && right == KNOWN_NUMBER;
+
      switch (operator) {
-          case TOKEN_BANG_EQUAL:    emit_bytes(OP_EQUAL, OP_NOT); break;
+          case TOKEN_BANG_EQUAL:    emit_bytes(OP_EQUAL, OP_NOT_BOOL); break;
           case TOKEN_EQUAL_EQUAL:   emit_byte(OP_EQUAL); break;
-          case TOKEN_GREATER:       emit_byte(OP_GREATER); break;
-          case TOKEN_GREATER_EQUAL: emit_bytes(OP_LESS, OP_NOT); break;
-          case TOKEN_LESS:          emit_byte(OP_LESS); break;
-          case TOKEN_LESS_EQUAL:    emit_bytes(OP_GREATER, OP_NOT); break;
-          case TOKEN_PLUS:          emit_byte(OP_ADD); break;
-          case TOKEN_MINUS:         emit_byte(OP_SUBTRACT); break;
-          case TOKEN_STAR:          emit_byte(OP_MULTIPLY); break;
-          case TOKEN_SLASH:         emit_byte(OP_DIVIDE); break;
+          case TOKEN_GREATER:
+               emit_byte(numbers ? OP_GREATER_NUM : OP_GREATER);
+               break;
+          case TOKEN_GREATER_EQUAL:
+               emit_bytes(numbers ? OP_LESS_NUM : OP_LESS, OP_NOT_BOOL);
+               break;
+          case TOKEN_LESS:
+               emit_byte(numbers ? OP_LESS_NUM : OP_LESS);
+               break;
+          case TOKEN_LESS_EQUAL:
+               emit_bytes(numbers ? OP_GREATER_NUM : OP_GREATER, OP_NOT_BOOL);
+               break;
+          case TOKEN_PLUS:
+               addition(left, right);
+               return;
+          case TOKEN_MINUS:
+               emit_byte(numbers ? OP_SUBTRACT_NUM : OP_SUBTRACT);
+               current->expr_type = KNOWN_NUMBER;
+               return;
+          case TOKEN_STAR:
+               emit_byte(numbers ? OP_MULTIPLY_NUM : OP_MULTIPLY);
+               current->expr_type = KNOWN_NUMBER;
+               return;
+          case TOKEN_SLASH:
+               emit_byte(numbers ? OP_DIVIDE_NUM : OP_DIVIDE);
+               current->expr_type = KNOWN_NUMBER;
+               return;
           default:
                return;
      }
+
+     //everything else is a comparison
+     current->expr_type = KNOWN_BOOL;
 }
 
 static void literal(bool can_assign) {
      switch (parse.previous.type) {
           case TOKEN_FALSE: emit_byte(OP_FALSE); break;
-          case TOKEN_NULL:  emit_byte(OP_NULL); break;
+          case TOKEN_NULL:  emit_byte(OP_NULL); return;
           case TOKEN_TRUE:  emit_byte(OP_TRUE); break;
           default:
                return;
      }
+     current->expr_type = KNOWN_BOOL;
 }
 
 static void grouping(bool can_assign) {
@@ -282,31 +939,47 @@ static void grouping(bool can_assign) {
 }
 
 static void number(bool can_assign) {
-     double val = strtod(parse.previous.start, NULL);
-     emit_constant(NUMBER_VAL(val));
+     double val = parse_number(parse.previous.start, parse.previous.length);
+
+     //literals without a fractional part become integers when they fit
+     if (memchr(parse.previous.start, '.', parse.previous.length) == NULL &&
+         val <= (double)INT_LIMIT) {
+          emit_constant(INT_VAL((int64_t)val));
+     } else {
+          emit_constant(NUMBER_VAL(val));
+     }
+     current->expr_type = KNOWN_NUMBER;
 }
 
 static void string(bool can_assign) {
-     emit_constant(OBJ_VAL(copy_string(parse.previous.start + 1,
-                                       parse.previous.length - 2)));
+     obj_string* string = copy_string(parse.previous.start + 1,
+                                      parse.previous.length - 2);
+     emit_constant(OBJ_VAL(string));
+     remember_string_constant(string, current_chunk()->constants.count - 1);
+     current->expr_type = KNOWN_STRING;
 }
 
 static void named_variable(token name, bool can_assign) {
      uint8_t get_op, set_op;
-     int arg = resolve_local(current, &name);
+     symbol* sym = intern_name(&name);
+     int arg = resolve_local(current, sym);
      if (arg != -1) {
           get_op = OP_GET_LOCAL;
           set_op = OP_SET_LOCAL;
      } else {
-          arg = identifier_constant(&name);
+          arg = identifier_constant(sym);
           get_op = OP_GET_GLOBAL;
           set_op = OP_SET_GLOBAL;
      }
      if (can_assign && match(TOKEN_EQUAL)) {
           expression();
           emit_bytes(set_op, (uint8_t)arg);
+          //from here on the local holds what was just assigned to it
+          if (set_op == OP_SET_LOCAL) current->locals[arg].type = current->expr_type;
      } else {
           emit_bytes(get_op, (uint8_t)arg);
+          current->expr_type = get_op == OP_GET_LOCAL
+               ? current->locals[arg].type : KNOWN_NOTHING;
      }
 }
 
@@ -321,19 +994,28 @@ static void unary(bool can_assign) {
      parse_prec(PREC_UNARY);
 
      //emit operator instruction
+     static_type operand = current->expr_type;
      switch (operator) {
-          case TOKEN_BANG:  emit_byte(OP_NOT); break;
-          case TOKEN_MINUS: emit_byte(OP_NEGATE); break;
+          case TOKEN_BANG:
+               emit_byte(operand == KNOWN_BOOL ? OP_NOT_BOOL : OP_NOT);
+               current->expr_type = KNOWN_BOOL;
+               break;
+          case TOKEN_MINUS:
+               emit_byte(operand == KNOWN_NUMBER ? OP_NEGATE_NUM : OP_NEGATE);
+               current->expr_type = KNOWN_NUMBER;
+               break;
           default:
                return;
      }
 }
 
 parse_rule rules[] = {
-     { grouping, NULL,    PREC_NONE },       // TOKEN_LEFT_PAREN
+     { grouping, call,    PREC_CALL },       // TOKEN_LEFT_PAREN
      { NULL,     NULL,    PREC_NONE },       // TOKEN_RIGHT_PAREN
      { NULL,     NULL,    PREC_NONE },       // TOKEN_LEFT_BRACE
      { NULL,     NULL,    PREC_NONE },       // TOKEN_RIGHT_BRACE
+     { array,    subscript, PREC_CALL },     // TOKEN_LEFT_BRACKET
+     { NULL,     NULL,    PREC_NONE },       // TOKEN_RIGHT_BRACKET
      { NULL,     NULL,    PREC_NONE },       // TOKEN_COMMA
      { NULL,     NULL,    PREC_NONE },       // TOKEN_DOT
      { unary,    binary,  PREC_TERM },       // TOKEN_MINUS
@@ -342,7 +1024,7 @@ parse_rule rules[] = {
      { NULL,     binary,  PREC_FACTOR },     // TOKEN_SLASH
      { NULL,     binary,  PREC_FACTOR },     // TOKEN_STAR
      { unary,    NULL,    PREC_NONE },       // TOKEN_BANG
-     { NULL,     NULL,    PREC_NONE },       // TOKEN_BANG_EQUAL
+     { NULL,     binary,  PREC_EQUALITY },   // TOKEN_BANG_EQUAL
      { NULL,     NULL,    PREC_NONE },       // TOKEN_EQUAL
      { NULL,     binary,  PREC_EQUALITY },   // TOKEN_EQUAL_EQUAL
      { NULL,     binary,  PREC_COMPARISON }, // TOKEN_GREATER
@@ -352,7 +1034,7 @@ parse_rule rules[] = {
      { variable, NULL,    PREC_NONE },       // TOKEN_IDENTIFIER
      { string,   NULL,    PREC_NONE },       // TOKEN_STRING
      { number,   NULL,    PREC_NONE },       // TOKEN_NUMBER
-     { NULL,     NULL,    PREC_NONE },       // TOKEN_AND
+     { NULL,     and_,    PREC_AND },        // TOKEN_AND
      { NULL,     NULL,    PREC_NONE },       // TOKEN_CLASS
      { NULL,     NULL,    PREC_NONE },       // TOKEN_ELSE
      { literal,  NULL,    PREC_NONE },       // TOKEN_FALSE
@@ -360,7 +1042,7 @@ parse_rule rules[] = {
      { NULL,     NULL,    PREC_NONE },       // TOKEN_FUNC
      { NULL,     NULL,    PREC_NONE },       // TOKEN_IF
      { literal,  NULL,    PREC_NONE },       // TOKEN_NULL
-     { NULL,     NULL,    PREC_NONE },       // TOKEN_OR
+     { NULL,     or_,     PREC_OR },         // TOKEN_OR
      { NULL,     NULL,    PREC_NONE },       // TOKEN_PRINT
      { NULL,     NULL,    PREC_NONE },       // TOKEN_RETURN
      { NULL,     NULL,    PREC_NONE },       // TOKEN_SUPER
@@ -384,6 +1066,7 @@ static void parse_prec(precedence prec) {
      }
 
      bool can_assign = prec <= PREC_ASSIGNMENT;
+     current->expr_type = KNOWN_NOTHING;
      prefix_rule(can_assign);
 
      while (prec <= get_rule(parse.current.type)->prec) {
@@ -403,10 +1086,11 @@ static uint8_t parse_variable(const char* error_msg) {
      declare_variable();
      if (current->scope_depth > 0) return 0;
 
-     return identifier_constant(&parse.previous);
+     return identifier_constant(intern_name(&parse.previous));
 }
 
 static void mark_init() {
+     if (current->scope_depth == 0) return;
      current->locals[current->local_count - 1].depth =
           current->scope_depth;
 }
@@ -436,16 +1120,56 @@ static void block() {
      consume(TOKEN_RIGHT_BRACE, "expected '}' after block");
 }
 
+static void function(function_type type) {
+     compiler c;
+     init_compiler(&c, type);
+     begin_scope();
+
+     consume(TOKEN_LEFT_PAREN, "expected '(' after function name");
+     if (!check(TOKEN_RIGHT_PAREN)) {
+          do {
+               current->function->arity++;
+               if (current->function->arity > 255) {
+                    error_at_current("cannot have more than 255 parameters");
+               }
+
+               uint8_t param = parse_variable("expected parameter name");
+               define_variable(param);
+          } while (match(TOKEN_COMMA));
+     }
+     consume(TOKEN_RIGHT_PAREN, "expected ')' after parameters");
+
+     consume(TOKEN_LEFT_BRACE, "expected '{' before function body");
+     block();
+
+     //no end_scope(), the locals go away with the call frame
+     obj_function* function = end_compiler();
+     emit_constant(OBJ_VAL(function));
+}
+
+static void func_declaration() {
+     uint8_t global = parse_variable("expected function name");
+     //a function can refer to itself, so its name is usable right away
+     mark_init();
+     function(TYPE_FUNCTION);
+     define_variable(global);
+}
+
 static void var_declaration() {
      uint8_t global = parse_variable("expected variable name");
 
+     static_type type = KNOWN_NOTHING;
      if (match(TOKEN_EQUAL)) {
           expression();
+          type = current->expr_type;
      } else {
           emit_byte(OP_NULL);
      }
 
      consume(TOKEN_SEMICOLON, "expected ';' after variable declaration");
+     if (current->scope_depth > 0) {
+          current->locals[current->local_count - 1].type = type;
+     }
      define_variable(global);
 }
 
@@ -461,6 +1185,235 @@ static void print_statement() {
      emit_byte(OP_PRINT);
 }
 
+/*   a call whose result is returned straight away is turned into a tail call,
+     which reuses the caller's frame instead of pushing a new one */
+static void return_statement() {
+     if (current->type == TYPE_SCRIPT) {
+          error("cannot return from top-level code");
+     }
+
+     if (match(TOKEN_SEMICOLON)) {
+          emit_return();
+          return;
+     }
+
+     expression();
+     consume(TOKEN_SEMICOLON, "expected ';' after return value");
+
+     chunk* ch = current_chunk();
+     if (current->last_call != -1 && current->last_call == ch->count - 2) {
+          ch->code[current->last_call] = OP_TAIL_CALL;
+     }
+     emit_byte(OP_RETURN);
+}
+
+static void if_statement() {
+     consume(TOKEN_LEFT_PAREN, "expected '(' after 'if'");
+     expression();
+     consume(TOKEN_RIGHT_PAREN, "expected ')' after condition");
+
+     int then_jump = emit_jump(OP_JUMP_IF_FALSE);
+     emit_byte(OP_POP);
+
+     //both branches start from the types after the condition
+     type_state before;
+     save_types(&before);
+     statement();
+
+     int else_jump = emit_jump(OP_JUMP);
+
+     patch_jump(then_jump);
+     emit_byte(OP_POP);
+
+     type_state then_types;
+     save_types(&then_types);
+     restore_types(&before);
+
+     if (match(TOKEN_ELSE)) statement();
+     patch_jump(else_jump);
+     merge_types(&then_types);
+}
+
+/*   compiles a loop condition followed by the jump out of the loop. the
+     common 'local < number' condition is rewritten into a single
+     OP_JUMP_IF_LOCAL_NOT_LESS, which compares without pushing anything */
+static loop_exit loop_condition() {
+     loop_exit exit;
+     chunk* ch = current_chunk();
+     int start = ch->count;
+
+     expression();
+
+     uint8_t* code = ch->code + start;
+     if (ch->count - start == 5 && code[0] == OP_GET_LOCAL &&
+         code[2] == OP_CONSTANT &&
+         (code[4] == OP_LESS || code[4] == OP_LESS_NUM) &&
+         IS_NUMBER(ch->constants.values[code[3]])) {
+          int line = ch->lines[start + 4];
+          exit.fused = true;
+          exit.slot = code[1];
+          exit.limit = code[3];
+
+          ch->count = start;
+          write_chunk(ch, OP_JUMP_IF_LOCAL_NOT_LESS, line);
+          write_chunk(ch, exit.slot, line);
+          write_chunk(ch, exit.limit, line);
+          write_chunk(ch, 0xff, line);
+          write_chunk(ch, 0xff, line);
+          exit.exit_jump = ch->count - 2;
+          return exit;
+     }
+
+     exit.fused = false;
+     exit.exit_jump = emit_jump(OP_JUMP_IF_FALSE);
+     emit_byte(OP_POP);
+     return exit;
+}
+
+//a plain condition leaves its value on the stack when the loop exits
+static void patch_loop_exit(loop_exit* exit) {
+     patch_jump(exit->exit_jump);
+     if (!exit->fused) emit_byte(OP_POP);
+}
+
+static void while_statement() {
+     loop_head head;
+     begin_loop(&head);
+
+     for (;;) {
+          int loop_start = current_chunk()->count;
+          consume(TOKEN_LEFT_PAREN, "expected '(' after 'while'");
+          loop_exit exit = loop_condition();
+          consume(TOKEN_RIGHT_PAREN, "expected ')' after condition");
+
+          //the loop is left with the types the condition was tested with
+          type_state exit_types;
+          save_types(&exit_types);
+
+          statement();
+          emit_loop(loop_start);
+
+          patch_loop_exit(&exit);
+
+          type_state back;
+          save_types(&back);
+          if (end_loop(&head, &back, true)) {
+               restore_types(&exit_types);
+               return;
+          }
+     }
+}
+
+//true for an increment compiled from exactly 'slot = slot + number'
+static bool is_counted_increment(code_fragment* incr, uint8_t slot) {
+     uint8_t* code = incr->code;
+     return incr->count == 8 &&
+            code[0] == OP_GET_LOCAL && code[1] == slot &&
+            code[2] == OP_CONSTANT &&
+            IS_NUMBER(current_chunk()->constants.values[code[3]]) &&
+            (code[4] == OP_ADD || code[4] == OP_ADD_NUM) &&
+            code[5] == OP_SET_LOCAL && code[6] == slot &&
+            code[7] == OP_POP;
+}
+
+/*   the increment clause is parsed before the body but runs after it, so its
+     bytecode is cut out of the chunk and emitted again after the body. it
+     can only jump within itself, so moving it is safe. a loop of the form
+     'for (...; i < limit; i = i + step)' ends in a single
+     OP_INCREMENT_LOCAL_LOOP that steps the counter, tests it and jumps back
+     to the top of the body, with the condition itself only run once to enter
+     the loop */
+static void for_statement() {
+     begin_scope();
+     consume(TOKEN_LEFT_PAREN, "expected '(' after 'for'");
+     if (match(TOKEN_SEMICOLON)) {
+          //no initializer
+     } else if (match(TOKEN_LET)) {
+          var_declaration();
+     } else {
+          expression_statement();
+     }
+
+     loop_head head;
+     begin_loop(&head);
+
+     for (;;) {
+          int loop_start = current_chunk()->count;
+          loop_exit exit = { 0, false, 0, 0 };
+          bool has_condition = !match(TOKEN_SEMICOLON);
+          if (has_condition) {
+               exit = loop_condition();
+               consume(TOKEN_SEMICOLON, "expected ';' after loop condition");
+          }
+
+          type_state exit_types;
+          save_types(&exit_types);
+
+          /*   the increment runs with the types the body ends with, which are
+               not known yet. it assumes the ones after the condition, except
+               for what an earlier pass found the body to change */
+          type_state step_types;
+          for (int i = 0; i < current->local_count; i++) {
+               if (head.forget[i]) current->locals[i].type = KNOWN_NOTHING;
+          }
+          save_types(&step_types);
+
+          code_fragment increment = { 0, NULL, NULL };
+          if (!match(TOKEN_RIGHT_PAREN)) {
+               int increment_start = current_chunk()->count;
+               expression();
+               emit_byte(OP_POP);
+               consume(TOKEN_RIGHT_PAREN, "expected ')' after for clauses");
+               cut_code(increment_start, &increment);
+          }
+
+          type_state back;
+          save_types(&back);
+          restore_types(&exit_types);
+
+          int body_start = current_chunk()->count;
+          statement();
+
+          bool stable = true;
+          for (int i = 0; i < step_types.count; i++) {
+               if (step_types.types[i] != KNOWN_NOTHING &&
+                   step_types.types[i] != current->locals[i].type) {
+                    forget_step(&head, i);
+                    stable = false;
+               }
+          }
+
+          if (has_condition && exit.fused &&
+              is_counted_increment(&increment, exit.slot)) {
+               chunk* ch = current_chunk();
+               int line = increment.lines[4];
+               write_chunk(ch, OP_INCREMENT_LOCAL_LOOP, line);
+               write_chunk(ch, exit.slot, line);
+               write_chunk(ch, increment.code[3], line);
+               write_chunk(ch, exit.limit, line);
+
+               int offset = ch->count - body_start + 2;
+               if (offset > UINT16_MAX) error("loop body too large");
+               write_chunk(ch, (offset >> 8) & 0xff, line);
+               write_chunk(ch, offset & 0xff, line);
+
+               patch_jump(exit.exit_jump);
+          } else {
+               paste_code(&increment);
+               emit_loop(loop_start);
+               if (has_condition) patch_loop_exit(&exit);
+          }
+
+          free_code(&increment);
+          if (end_loop(&head, &back, stable)) {
+               restore_types(&exit_types);
+               break;
+          }
+     }
+
+     end_scope();
+}
+
 static void synchronize() {
      parse.panic = false;
 
@@ -485,8 +1438,22 @@ static void synchronize() {
      }
 }
 
+/*   with coverage enabled, a statement first counts itself on the line its
+     first token is on. nothing that looks back at the code emitted so far
+     (tail calls, loop fusion) spans a statement boundary, so those are not
+     disturbed by it */
+static void count_line(int line) {
+     if (!coverage.enabled) return;
+     mark_line(line);
+     write_chunk(current_chunk(), OP_COUNT, line);
+}
+
 static void declaration() {
-     if (match(TOKEN_LET)) {
+     if (match(TOKEN_FUNC)) {
+          count_line(parse.previous.line);
+          func_declaration();
+     } else if (match(TOKEN_LET)) {
+          count_line(parse.previous.line);
           var_declaration();
      } else {
           statement();
@@ -496,8 +1463,18 @@ static void declaration() {
 }
 
 static void statement() {
+     //a block only groups statements that count themselves
+     if (!check(TOKEN_LEFT_BRACE)) count_line(parse.current.line);
      if (match(TOKEN_PRINT)) {
           print_statement();
+     } else if (match(TOKEN_IF)) {
+          if_statement();
+     } else if (match(TOKEN_RETURN)) {
+          return_statement();
+     } else if (match(TOKEN_WHILE)) {
+          while_statement();
+     } else if (match(TOKEN_FOR)) {
+          for_statement();
      } else if (match(TOKEN_LEFT_BRACE)) {
          begin_scope();
          block();
@@ -507,13 +1484,38 @@ static void statement() {
      }
 }
 
-//this function compiles the given chunk into bytecode until it reaches EOF
-//reports errors through return value
-bool compile(const char* source, chunk* chunk) {
+//what the arenas keep backed between compiles, so small scripts fault nothing
+#define ARENA_KEEP (64 * 1024)
+
+static void reserve(arena* a, size_t size) {
+     if (a->base != NULL && a->size >= size) return;
+     free_arena(a);
+     init_arena(a, size);
+}
+
+/*   makes room for the bytecode of a source of 'length' characters. the
+     reservation is only backed by memory as far as it is used, and kept for
+     the next compile. a chunk that outgrows it moves to the heap */
+static void reserve_arenas(size_t length) {
+     size_t code = 2 * length + ARENA_KEEP;
+     reserve(&arenas.code, code);
+     reserve(&arenas.lines, sizeof(int) * code);
+     reserve(&arenas.constants, sizeof(value) * (length / 2) + ARENA_KEEP);
+}
+
+static void trim_arenas() {
+     trim_arena(&arenas.code, ARENA_KEEP);
+     trim_arena(&arenas.lines, ARENA_KEEP);
+     trim_arena(&arenas.constants, ARENA_KEEP);
+}
+
+//this function compiles the given source into the top-level script function
+//until it reaches EOF, returns NULL if there were compile errors
+obj_function* compile(const char* source) {
+     reserve_arenas(strlen(source));
      init_scanner(source);    //tokenize source text
      compiler c;
-     init_compiler(&c);
-     compiling = chunk;
+     init_compiler(&c, TYPE_SCRIPT);
      parse.had_error = false;
      parse.panic = false;
 
@@ -521,9 +1523,13 @@ bool compile(const char* source, chunk* chunk) {
 
      while (!match(TOKEN_EOF)) {
           declaration();      //keep compiling declarations until EOF
+          if (current->scope_depth == 0) forget_symbols();
      }
 
      consume(TOKEN_EOF, "expected end of expression");
-     end_compiler();
-     return !parse.had_error;
+     obj_function* function = end_compiler();
+     free_symbols();
+     free_loops();
+     trim_arenas();
+     return parse.had_error ? NULL : function;
 }
@@ -4,6 +4,6 @@
 #include "object.h"
 #include "vm.h"
 
-bool compile(const char* source, chunk* chunk);
+obj_function* compile(const char* source);
 
 #endif
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "coverage.h"
+#include "memory.h"
+
+coverage_counters coverage;
+
+void enable_coverage() {
+     coverage.enabled = true;
+     coverage.line_count = 0;
+     coverage.counts = NULL;
+     coverage.instrumented = NULL;
+}
+
+void free_coverage() {
+     FREE_ARRAY(uint64_t, coverage.counts, coverage.line_count);
+     FREE_ARRAY(bool, coverage.instrumented, coverage.line_count);
+     coverage.enabled = false;
+     coverage.line_count = 0;
+}
+
+void mark_line(int line) {
+     if (line >= coverage.line_count) {
+          int old_count = coverage.line_count;
+          int count = GROW_CAPACITY(old_count);
+          while (count <= line) count *= 2;
+
+          coverage.counts = GROW_ARRAY(coverage.counts, uint64_t, old_count, count);
+          coverage.instrumented = GROW_ARRAY(coverage.instrumented, bool,
+                                             old_count, count);
+          memset(coverage.counts + old_count, 0,
+                 sizeof(uint64_t) * (count - old_count));
+          memset(coverage.instrumented + old_count, 0,
+                 sizeof(bool) * (count - old_count));
+          coverage.line_count = count;
+     }
+     coverage.instrumented[line] = true;
+}
+
+static FILE* open_report(const char* prefix, const char* extension) {
+     size_t length = strlen(prefix) + strlen(extension) + 1;
+     char* path = malloc(length);
+     snprintf(path, length, "%s%s", prefix, extension);
+
+     FILE* file = fopen(path, "w");
+     if (file == NULL) fprintf(stderr, "could not open file \"%s\".\n", path);
+     free(path);
+     return file;
+}
+
+bool write_coverage(const char* source_path, const char* prefix) {
+     FILE* counts = open_report(prefix, ".counts");
+     if (counts == NULL) return false;
+     for (int line = 0; line < coverage.line_count; line++) {
+          if (!coverage.instrumented[line]) continue;
+          fprintf(counts, "%d %llu\n", line,
+                  (unsigned long long)coverage.counts[line]);
+     }
+     fclose(counts);
+
+     FILE* source = fopen(source_path, "r");
+     if (source == NULL) {
+          fprintf(stderr, "could not open file \"%s\".\n", source_path);
+          return false;
+     }
+     FILE* report = open_report(prefix, ".cov");
+     if (report == NULL) {
+          fclose(source);
+          return false;
+     }
+
+     //like gcov, '-' marks lines without statements and '#####' ones that
+     //never ran
+     int line = 1;
+     bool line_start = true;
+     int c;
+     while ((c = fgetc(source)) != EOF) {
+          if (line_start) {
+               bool counted = line < coverage.line_count &&
+                              coverage.instrumented[line];
+               if (!counted) {
+                    fprintf(report, "%12s:%6d: ", "-", line);
+               } else if (coverage.counts[line] == 0) {
+                    fprintf(report, "%12s:%6d: ", "#####", line);
+               } else {
+                    fprintf(report, "%12llu:%6d: ",
+                            (unsigned long long)coverage.counts[line], line);
+               }
+               line_start = false;
+          }
+          fputc(c, report);
+          if (c == '\n') {
+               line++;
+               line_start = true;
+          }
+     }
+     if (!line_start) fputc('\n', report);
+
+     fclose(source);
+     fclose(report);
+     return true;
+}
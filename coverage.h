@@ -0,0 +1,29 @@
+#ifndef klox_coverage_h
+#define klox_coverage_h
+
+#include "common.h"
+
+/*   per-line execution counts. while enabled, the compiler starts every
+     statement and declaration with an OP_COUNT, which adds one to the
+     counter of the line the instruction is on. with it disabled nothing is
+     emitted and the bytecode is the same as without this file */
+typedef struct {
+     bool enabled;
+     int line_count;          //counters allocated, indexed by line number
+     uint64_t* counts;
+     bool* instrumented;      //lines with at least one OP_COUNT on them
+} coverage_counters;
+
+extern coverage_counters coverage;
+
+void enable_coverage(void);
+void free_coverage(void);
+
+//called by the compiler for each OP_COUNT it emits
+void mark_line(int line);
+
+/*   writes '<prefix>.counts' with a "line count" pair per instrumented line
+     and '<prefix>.cov', the source annotated with the counts */
+bool write_coverage(const char* source_path, const char* prefix);
+
+#endif
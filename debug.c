@@ -3,6 +3,61 @@
 #include "debug.h"
 #include "value.h"
 
+static const char* opcode_names[] = {
+     [OP_CONSTANT] = "OP_CONSTANT",
+     [OP_CONSTANT_LONG] = "OP_CONSTANT_LONG",
+     [OP_NULL] = "OP_NULL",
+     [OP_TRUE] = "OP_TRUE",
+     [OP_FALSE] = "OP_FALSE",
+     [OP_POP] = "OP_POP",
+     [OP_GET_LOCAL] = "OP_GET_LOCAL",
+     [OP_SET_LOCAL] = "OP_SET_LOCAL",
+     [OP_GET_GLOBAL] = "OP_GET_GLOBAL",
+     [OP_DEFINE_GLOBAL] = "OP_DEFINE_GLOBAL",
+     [OP_SET_GLOBAL] = "OP_SET_GLOBAL",
+     [OP_EQUAL] = "OP_EQUAL",
+     [OP_GREATER] = "OP_GREATER",
+     [OP_LESS] = "OP_LESS",
+     [OP_ADD] = "OP_ADD",
+     [OP_SUBTRACT] = "OP_SUBTRACT",
+     [OP_MULTIPLY] = "OP_MULTIPLY",
+     [OP_DIVIDE] = "OP_DIVIDE",
+     [OP_NOT] = "OP_NOT",
+     [OP_NEGATE] = "OP_NEGATE",
+     [OP_CONCAT] = "OP_CONCAT",
+     [OP_ADD_NUM] = "OP_ADD_NUM",
+     [OP_ADD_STR] = "OP_ADD_STR",
+     [OP_SUBTRACT_NUM] = "OP_SUBTRACT_NUM",
+     [OP_MULTIPLY_NUM] = "OP_MULTIPLY_NUM",
+     [OP_DIVIDE_NUM] = "OP_DIVIDE_NUM",
+     [OP_GREATER_NUM] = "OP_GREATER_NUM",
+     [OP_LESS_NUM] = "OP_LESS_NUM",
+     [OP_NOT_BOOL] = "OP_NOT_BOOL",
+     [OP_NEGATE_NUM] = "OP_NEGATE_NUM",
+     [OP_PRINT] = "OP_PRINT",
+     [OP_BUILD_ARRAY] = "OP_BUILD_ARRAY",
+     [OP_INDEX_GET] = "OP_INDEX_GET",
+     [OP_INDEX_SET] = "OP_INDEX_SET",
+     [OP_CALL] = "OP_CALL",
+     [OP_TAIL_CALL] = "OP_TAIL_CALL",
+     [OP_JUMP] = "OP_JUMP",
+     [OP_JUMP_IF_FALSE] = "OP_JUMP_IF_FALSE",
+     [OP_LOOP] = "OP_LOOP",
+     [OP_JUMP_IF_LOCAL_NOT_LESS] = "OP_JUMP_IF_LOCAL_NOT_LESS",
+     [OP_INCREMENT_LOCAL_LOOP] = "OP_INCREMENT_LOCAL_LOOP",
+     [OP_COUNT] = "OP_COUNT",
+     [OP_RETURN] = "OP_RETURN",
+};
+
+//name of the given opcode, used when decoding execution traces
+const char* opcode_name(uint8_t instruction) {
+     int count = sizeof(opcode_names) / sizeof(opcode_names[0]);
+     if (instruction >= count || opcode_names[instruction] == NULL) {
+          return "OP_UNKNOWN";
+     }
+     return opcode_names[instruction];
+}
+
 void disassemble_chunk(chunk* chunk, const char* name) {
      printf("== %s ==\n", name);
 
@@ -19,6 +74,17 @@ static int constant_instruction(const char* name, chunk* chunk, int offset) {
      return offset + 2;
 }
 
+static int constant_long_instruction(const char* name, chunk* chunk,
+                                     int offset) {
+     int constant = chunk->code[offset + 1] |
+                    (chunk->code[offset + 2] << 8) |
+                    (chunk->code[offset + 3] << 16);
+     printf("%-16s %4d '", name, constant);
+     print_value(chunk->constants.values[constant]);
+     printf("'\n");
+     return offset + 4;
+}
+
 static int simple_instruction(const char* name, int offset) {
      printf("%s\n", name);
      return offset + 1;
@@ -31,6 +97,41 @@ static int byte_instruction(const char* name, chunk* chunk,
      return offset + 2;
 }
 
+static int jump_instruction(const char* name, int sign, chunk* chunk,
+                            int offset) {
+     uint16_t jump = (uint16_t)(chunk->code[offset + 1] << 8);
+     jump |= chunk->code[offset + 2];
+     printf("%-16s %4d -> %d\n", name, offset, offset + 3 + sign * jump);
+     return offset + 3;
+}
+
+//local slot, limit constant, forward jump
+static int local_jump_instruction(const char* name, chunk* chunk, int offset) {
+     uint8_t slot = chunk->code[offset + 1];
+     uint8_t limit = chunk->code[offset + 2];
+     uint16_t jump = (uint16_t)(chunk->code[offset + 3] << 8);
+     jump |= chunk->code[offset + 4];
+     printf("%-16s %4d < '", name, slot);
+     print_value(chunk->constants.values[limit]);
+     printf("' -> %d\n", offset + 5 + jump);
+     return offset + 5;
+}
+
+//local slot, step constant, limit constant, backward jump
+static int local_loop_instruction(const char* name, chunk* chunk, int offset) {
+     uint8_t slot = chunk->code[offset + 1];
+     uint8_t step = chunk->code[offset + 2];
+     uint8_t limit = chunk->code[offset + 3];
+     uint16_t jump = (uint16_t)(chunk->code[offset + 4] << 8);
+     jump |= chunk->code[offset + 5];
+     printf("%-16s %4d += '", name, slot);
+     print_value(chunk->constants.values[step]);
+     printf("' < '");
+     print_value(chunk->constants.values[limit]);
+     printf("' -> %d\n", offset + 6 - jump);
+     return offset + 6;
+}
+
 int disassemble_instruction(chunk* chunk, int offset) {
      printf("%04d ", offset);
 
@@ -44,6 +145,9 @@ int disassemble_instruction(chunk* chunk, int offset) {
      switch (instruction) {
           case OP_CONSTANT:
                return constant_instruction("OP_CONSTANT", chunk, offset);
+          case OP_CONSTANT_LONG:
+               return constant_long_instruction("OP_CONSTANT_LONG", chunk,
+                                                offset);
           case OP_NULL:
                return simple_instruction("OP_NULL", offset);
           case OP_TRUE:
@@ -80,8 +184,44 @@ int disassemble_instruction(chunk* chunk, int offset) {
                return simple_instruction("OP_NOT", offset);
           case OP_NEGATE:
                return simple_instruction("OP_NEGATE", offset);
+          case OP_CONCAT:
+               return byte_instruction("OP_CONCAT", chunk, offset);
+          case OP_ADD_NUM:
+          case OP_ADD_STR:
+          case OP_SUBTRACT_NUM:
+          case OP_MULTIPLY_NUM:
+          case OP_DIVIDE_NUM:
+          case OP_GREATER_NUM:
+          case OP_LESS_NUM:
+          case OP_NOT_BOOL:
+          case OP_NEGATE_NUM:
+               return simple_instruction(opcode_name(instruction), offset);
           case OP_PRINT:
                return simple_instruction("OP_PRINT", offset);
+          case OP_BUILD_ARRAY:
+               return byte_instruction("OP_BUILD_ARRAY", chunk, offset);
+          case OP_INDEX_GET:
+               return simple_instruction("OP_INDEX_GET", offset);
+          case OP_INDEX_SET:
+               return simple_instruction("OP_INDEX_SET", offset);
+          case OP_CALL:
+               return byte_instruction("OP_CALL", chunk, offset);
+          case OP_TAIL_CALL:
+               return byte_instruction("OP_TAIL_CALL", chunk, offset);
+          case OP_JUMP:
+               return jump_instruction("OP_JUMP", 1, chunk, offset);
+          case OP_JUMP_IF_FALSE:
+               return jump_instruction("OP_JUMP_IF_FALSE", 1, chunk, offset);
+          case OP_LOOP:
+               return jump_instruction("OP_LOOP", -1, chunk, offset);
+          case OP_JUMP_IF_LOCAL_NOT_LESS:
+               return local_jump_instruction("OP_JUMP_IF_LOCAL_NOT_LESS", chunk,
+                                             offset);
+          case OP_INCREMENT_LOCAL_LOOP:
+               return local_loop_instruction("OP_INCREMENT_LOCAL_LOOP", chunk,
+                                             offset);
+          case OP_COUNT:
+               return simple_instruction("OP_COUNT", offset);
           case OP_RETURN:
                return simple_instruction("OP_RETURN", offset);
           default:
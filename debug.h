@@ -5,5 +5,6 @@
 
 void disassemble_chunk(chunk* chunk, const char* name);
 int disassemble_instruction(chunk* chunk, int offset);
+const char* opcode_name(uint8_t instruction);
 
 #endif
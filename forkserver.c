@@ -0,0 +1,219 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "forkserver.h"
+#include "memory.h"
+#include "socket.h"
+#include "vm.h"
+
+//a forked job and the connection its status goes to
+typedef struct {
+     pid_t pid;
+     int conn;
+} worker;
+
+static worker* workers = NULL;
+static int worker_count = 0;
+static int worker_capacity = 0;
+
+//SIGCHLD writes here so poll() wakes up to reap
+static int wake_pipe[2];
+
+static void on_child_exit(int signal) {
+     int saved_errno = errno;
+     (void)signal;
+     (void)!write(wake_pipe[1], "", 1);
+     errno = saved_errno;
+}
+
+//reads until the other side shuts down its writing half, NULL on errors
+static char* read_all(int fd, size_t* length) {
+     size_t count = 0;
+     size_t capacity = 4096;
+     char* chars = malloc(capacity);
+
+     for (;;) {
+          if (chars == NULL) return NULL;
+          if (capacity - count < 1024) {
+               capacity *= 2;
+               char* grown = realloc(chars, capacity);
+               if (grown == NULL) free(chars);
+               chars = grown;
+               continue;
+          }
+
+          ssize_t bytes = read(fd, chars + count, capacity - count - 1);
+          if (bytes == 0) break;
+          if (bytes < 0) {
+               if (errno == EINTR) continue;
+               free(chars);
+               return NULL;
+          }
+          count += bytes;
+     }
+
+     chars[count] = '\0';
+     *length = count;
+     return chars;
+}
+
+//runs in the forked worker, which never returns to the server loop
+static void run_job(int conn) {
+     size_t length;
+     char* source = read_all(conn, &length);
+     if (source == NULL) _exit(74);
+
+     dup2(conn, STDOUT_FILENO);
+     dup2(conn, STDERR_FILENO);
+     close(conn);
+
+     result res = interpret(source);
+     flush_output(&vm.out);
+     fflush(stderr);
+
+     if (res == RESULT_COMPILE_ERROR) _exit(65);
+     if (res == RESULT_RUNTIME_ERROR) _exit(70);
+     _exit(0);
+}
+
+static void reap_workers() {
+     int status;
+     pid_t pid;
+     while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+          for (int i = 0; i < worker_count; i++) {
+               if (workers[i].pid != pid) continue;
+
+               char trailer[32];
+               int length;
+               if (WIFEXITED(status)) {
+                    length = snprintf(trailer, sizeof(trailer), "%cexit %d\n",
+                                      '\0', WEXITSTATUS(status));
+               } else {
+                    length = snprintf(trailer, sizeof(trailer), "%csignal %d\n",
+                                      '\0', WTERMSIG(status));
+               }
+               send(workers[i].conn, trailer, length, MSG_NOSIGNAL);
+               close(workers[i].conn);
+
+               workers[i] = workers[--worker_count];
+               break;
+          }
+     }
+}
+
+static void start_worker(int listener, int conn) {
+     pid_t pid = fork();
+     if (pid < 0) {
+          close(conn);
+          return;
+     }
+
+     if (pid == 0) {
+          signal(SIGCHLD, SIG_DFL);
+          close(listener);
+          close(wake_pipe[0]);
+          close(wake_pipe[1]);
+          run_job(conn);
+     }
+
+     if (worker_capacity < worker_count + 1) {
+          int old_capacity = worker_capacity;
+          worker_capacity = GROW_CAPACITY(old_capacity);
+          workers = GROW_ARRAY(workers, worker, old_capacity, worker_capacity);
+     }
+     workers[worker_count].pid = pid;
+     workers[worker_count].conn = conn;
+     worker_count++;
+}
+
+//serves until the process is killed, returns only if it cannot start
+void run_fork_server(const char* socket_path) {
+     //nothing buffered may be inherited and written again by every worker
+     flush_output(&vm.out);
+     fflush(stderr);
+
+     int listener = listen_on(socket_path);
+     if (listener < 0) return;
+     if (pipe(wake_pipe) != 0) return;
+     fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+     fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+
+     struct sigaction action;
+     memset(&action, 0, sizeof(action));
+     action.sa_handler = on_child_exit;
+     action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+     sigaction(SIGCHLD, &action, NULL);
+     signal(SIGPIPE, SIG_IGN);
+
+     for (;;) {
+          struct pollfd fds[2] = {
+               { .fd = listener, .events = POLLIN },
+               { .fd = wake_pipe[0], .events = POLLIN }
+          };
+          if (poll(fds, 2, -1) < 0 && errno != EINTR) break;
+
+          if (fds[1].revents & POLLIN) {
+               char drain[64];
+               while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+          }
+          reap_workers();
+
+          if (fds[0].revents & POLLIN) {
+               int conn = accept(listener, NULL, NULL);
+               if (conn >= 0) start_worker(listener, conn);
+          }
+     }
+     close(listener);
+}
+
+/*   sends one job and copies what it printed to stdout. returns the worker's
+     exit status, or 128 plus the signal that killed it like a shell would */
+int run_fork_client(const char* socket_path, const char* source) {
+     int conn = connect_to(socket_path);
+     if (conn < 0) return 74;
+
+     size_t length = strlen(source);
+     for (size_t sent = 0; sent < length;) {
+          ssize_t bytes = write(conn, source + sent, length - sent);
+          if (bytes < 0) {
+               if (errno == EINTR) continue;
+               fprintf(stderr, "could not send the job to \"%s\".\n", socket_path);
+               return 74;
+          }
+          sent += bytes;
+     }
+     shutdown(conn, SHUT_WR);
+
+     size_t response_length;
+     char* response = read_all(conn, &response_length);
+     close(conn);
+     if (response == NULL) return 74;
+
+     //the script's output ends at the NUL that starts the trailer
+     size_t output_length = strlen(response);
+     fwrite(response, 1, output_length, stdout);
+     fflush(stdout);
+
+     int status = 74;
+     int number;
+     const char* trailer = response + output_length + 1;
+     if (output_length == response_length) {
+          fprintf(stderr, "the server closed the connection early.\n");
+     } else if (sscanf(trailer, "exit %d", &number) == 1) {
+          status = number;
+     } else if (sscanf(trailer, "signal %d", &number) == 1) {
+          fprintf(stderr, "the worker was killed by signal %d.\n", number);
+          status = 128 + number;
+     }
+     free(response);
+     return status;
+}
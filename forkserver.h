@@ -0,0 +1,18 @@
+#ifndef klox_forkserver_h
+#define klox_forkserver_h
+
+#include "common.h"
+
+/*   a fork server. the parent keeps the VM it was started with (natives,
+     prelude, image) and forks a worker per connection on a Unix socket, so
+     every job starts from a copy-on-write copy of that warm heap and cannot
+     hurt the parent or other jobs.
+
+     a client sends the script's source and shuts down its writing side. it
+     gets back everything the script printed to stdout and stderr, then a
+     NUL byte and a line "exit <status>" or "signal <number>" once the
+     worker is gone */
+void run_fork_server(const char* socket_path);
+int run_fork_client(const char* socket_path, const char* source);
+
+#endif
@@ -0,0 +1,716 @@
+#include <string.h>
+#include <sys/mman.h>
+
+#include "chunk.h"
+#include "common.h"
+#include "coverage.h"
+#include "jit.h"
+#include "memory.h"
+#include "object.h"
+#include "output.h"
+#include "table.h"
+#include "value.h"
+#include "vm.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+/*   a baseline JIT. every instruction is translated on its own into a fixed
+     machine code template, with no analysis across instructions. the code
+     keeps the top of the VM stack in rbx and the frame's slots in r12, so
+     the stack in memory is always exactly what the interpreter would see.
+     that is what lets the code give up at any instruction it cannot handle,
+     a type it does not expect or an error, and return its offset so the
+     interpreter carries on from there */
+
+typedef uint32_t (*jit_entry_fn)(value* stack_top, value* slots, uint8_t* entry);
+
+//a rel32 to fill in once the bytecode offset it refers to has code
+typedef struct {
+     int at;
+     int target;
+} jit_patch;
+
+typedef struct {
+     uint8_t* code;
+     int count;
+     int capacity;
+     jit_patch* jumps;        //jumps to the code of another instruction
+     int jump_count;
+     int jump_capacity;
+     jit_patch* exits;        //jumps to the stub that exits at an instruction
+     int exit_count;
+     int exit_capacity;
+} assembler;
+
+//second opcode byte of the rel32 conditional jumps
+typedef enum {
+     CC_O  = 0x80,
+     CC_E  = 0x84,
+     CC_NE = 0x85,
+     CC_L  = 0x8c,
+     CC_GE = 0x8d,
+     CC_G  = 0x8f,
+     CC_ALWAYS = 0
+} condition;
+
+//where in a value its type tag and payload are
+#define TYPE(disp)    (disp)
+#define PAYLOAD(disp) ((disp) + 8)
+
+//stack slots relative to rbx, the first free slot
+#define TOP     -16
+#define SECOND  -32
+#define THIRD   -48
+
+/*------------------------------ code emission -------------------------------*/
+
+static void emit(assembler* as, const uint8_t* bytes, int count) {
+     if (as->capacity < as->count + count) {
+          int old_capacity = as->capacity;
+          while (as->capacity < as->count + count) {
+               as->capacity = GROW_CAPACITY(as->capacity);
+          }
+          as->code = GROW_ARRAY(as->code, uint8_t, old_capacity, as->capacity);
+     }
+     memcpy(as->code + as->count, bytes, count);
+     as->count += count;
+}
+
+#define EMIT(...) \
+     do { \
+          const uint8_t bytes_[] = { __VA_ARGS__ }; \
+          emit(as, bytes_, sizeof(bytes_)); \
+     } while (false)
+
+static void emit32(assembler* as, uint32_t bits) {
+     emit(as, (uint8_t*)&bits, 4);
+}
+
+static void emit64(assembler* as, uint64_t bits) {
+     emit(as, (uint8_t*)&bits, 8);
+}
+
+static void add_patch(jit_patch** patches, int* count, int* capacity,
+                      int at, int target) {
+     if (*capacity < *count + 1) {
+          int old_capacity = *capacity;
+          *capacity = GROW_CAPACITY(old_capacity);
+          *patches = GROW_ARRAY(*patches, jit_patch, old_capacity, *capacity);
+     }
+     (*patches)[*count].at = at;
+     (*patches)[*count].target = target;
+     (*count)++;
+}
+
+//emits a jump with an empty rel32 and returns where that rel32 is
+static int emit_jump_to(assembler* as, condition cc) {
+     if (cc == CC_ALWAYS) {
+          EMIT(0xe9);
+     } else {
+          EMIT(0x0f, cc);
+     }
+     emit32(as, 0);
+     return as->count - 4;
+}
+
+//points the rel32 at 'at' to the next byte to be emitted
+static void bind(assembler* as, int at) {
+     int32_t rel = as->count - (at + 4);
+     memcpy(as->code + at, &rel, 4);
+}
+
+//leaves the machine code at instruction 'offset' when 'cc' holds
+static void exit_if(assembler* as, condition cc, int offset) {
+     int at = emit_jump_to(as, cc);
+     add_patch(&as->exits, &as->exit_count, &as->exit_capacity, at, offset);
+}
+
+//jumps to the code of the instruction at bytecode offset 'target'
+static void jump_if(assembler* as, condition cc, int target) {
+     int at = emit_jump_to(as, cc);
+     add_patch(&as->jumps, &as->jump_count, &as->jump_capacity, at, target);
+}
+
+static void call_helper(assembler* as, void* helper) {
+     EMIT(0x48, 0xb8);                            //mov rax, helper
+     emit64(as, (uint64_t)(uintptr_t)helper);
+     EMIT(0xff, 0xd0);                            //call rax
+}
+
+static void push_value(assembler* as, value val) {
+     uint64_t bits[2];
+     memcpy(bits, &val, sizeof(bits));
+     EMIT(0x48, 0xb8); emit64(as, bits[0]);       //mov rax, imm64
+     EMIT(0x48, 0x89, 0x03);                      //mov [rbx], rax
+     EMIT(0x48, 0xb8); emit64(as, bits[1]);       //mov rax, imm64
+     EMIT(0x48, 0x89, 0x43, 0x08);                //mov [rbx + 8], rax
+     EMIT(0x48, 0x83, 0xc3, 0x10);                //add rbx, 16
+}
+
+static void drop(assembler* as, int count) {
+     EMIT(0x48, 0x83, 0xeb, (uint8_t)(count * 16)); //sub rbx, 16 * count
+}
+
+static void check_type(assembler* as, int disp, val_type type) {
+     EMIT(0x83, 0x7b, (uint8_t)TYPE(disp), type); //cmp dword [rbx + d], type
+}
+
+static void set_type(assembler* as, int disp, val_type type) {
+     EMIT(0xc7, 0x43, (uint8_t)TYPE(disp));       //mov dword [rbx + d], type
+     emit32(as, type);
+}
+
+static void check_slot_type(assembler* as, int slot, val_type type) {
+     EMIT(0x41, 0x83, 0xbc, 0x24);                //cmp dword [r12 + d32], type
+     emit32(as, slot * sizeof(value));
+     EMIT(type);
+}
+
+//the int64 range the interpreter keeps integers in, see INT_LIMIT
+static void exit_unless_int_range(assembler* as, int offset) {
+     EMIT(0x48, 0xb9); emit64(as, INT_LIMIT);     //mov rcx, INT_LIMIT
+     EMIT(0x48, 0x39, 0xc8);                      //cmp rax, rcx
+     exit_if(as, CC_G, offset);
+     EMIT(0x48, 0xf7, 0xd9);                      //neg rcx
+     EMIT(0x48, 0x39, 0xc8);                      //cmp rax, rcx
+     exit_if(as, CC_L, offset);
+}
+
+//loads the number at [rbx + disp] into xmm 'reg' as a double
+static void load_double(assembler* as, int reg, int disp, int offset) {
+     uint8_t modrm = 0x43 | (reg << 3);
+     check_type(as, disp, VAL_NUMBER);
+     int not_double = emit_jump_to(as, CC_NE);
+     EMIT(0xf2, 0x0f, 0x10, modrm, (uint8_t)PAYLOAD(disp)); //movsd xmm, [..]
+     int done = emit_jump_to(as, CC_ALWAYS);
+
+     bind(as, not_double);
+     check_type(as, disp, VAL_INT);
+     exit_if(as, CC_NE, offset);
+     EMIT(0xf2, 0x48, 0x0f, 0x2a, modrm, (uint8_t)PAYLOAD(disp)); //cvtsi2sd
+     bind(as, done);
+}
+
+/*------------------------------ helpers in C --------------------------------*/
+
+//helpers that return false have not changed anything, the interpreter then
+//runs the same instruction again and reports whatever went wrong
+
+static bool jit_get_global(obj_string* name, value* into) {
+     return table_get(&vm.globals, name, into);
+}
+
+static bool jit_set_global(obj_string* name, value* val) {
+     if (table_set(&vm.globals, name, *val)) {
+          table_delete(&vm.globals, name);
+          return false;
+     }
+     return true;
+}
+
+static void jit_define_global(obj_string* name, value* val) {
+     table_set(&vm.globals, name, *val);
+}
+
+static bool jit_equal(value* operands) {
+     return values_equal(operands[0], operands[1]);
+}
+
+static void jit_print(value* val) {
+     write_value(&vm.out, *val);
+     write_char(&vm.out, '\n');
+}
+
+static value* jit_build_array(value* top, int count) {
+     obj_array* array = new_array();
+     for (value* element = top - count; element < top; element++) {
+          write_val_array(&array->items, *element);
+     }
+
+     top -= count;
+     *top = OBJ_VAL(array);
+     return top + 1;
+}
+
+//the new top of the stack, or NULL when the interpreter has to report an error
+static value* jit_concat(value* top, int count) {
+     vm.stack_top = top;
+     return add_all(count) ? vm.stack_top : NULL;
+}
+
+//only the common case of an integer index, the interpreter does the rest
+static bool jit_index_get(value* top) {
+     value target = top[-2];
+     value index = top[-1];
+     if (!IS_ARRAY(target) || !IS_INT(index)) return false;
+
+     val_array* items = &AS_ARRAY(target)->items;
+     if (AS_INT(index) < 0 || AS_INT(index) >= items->count) return false;
+     top[-2] = items->values[AS_INT(index)];
+     return true;
+}
+
+static bool jit_index_set(value* top) {
+     value target = top[-3];
+     value index = top[-2];
+     if (!IS_ARRAY(target) || !IS_INT(index)) return false;
+
+     val_array* items = &AS_ARRAY(target)->items;
+     if (AS_INT(index) < 0 || AS_INT(index) >= items->count) return false;
+     items->values[AS_INT(index)] = top[-1];
+     top[-3] = top[-1];
+     return true;
+}
+
+/*------------------------------ the templates -------------------------------*/
+
+typedef enum {
+     ARITH_ADD,
+     ARITH_SUBTRACT,
+     ARITH_MULTIPLY,
+     ARITH_DIVIDE
+} arith_op;
+
+/*   integers stay integers while the result is in range, like add_numbers
+     and friends. a product of zero could be -0, so that goes back to the
+     interpreter along with overflows */
+static void arithmetic(assembler* as, arith_op op, int offset) {
+     int not_ints[2] = { -1, -1 };
+     int done = -1;
+
+     if (op != ARITH_DIVIDE) {
+          check_type(as, SECOND, VAL_INT);
+          not_ints[0] = emit_jump_to(as, CC_NE);
+          check_type(as, TOP, VAL_INT);
+          not_ints[1] = emit_jump_to(as, CC_NE);
+
+          EMIT(0x48, 0x8b, 0x43, (uint8_t)PAYLOAD(SECOND)); //mov rax, [a]
+          EMIT(0x48, 0x8b, 0x4b, (uint8_t)PAYLOAD(TOP));    //mov rcx, [b]
+          switch (op) {
+               case ARITH_ADD:      EMIT(0x48, 0x01, 0xc8); break;
+               case ARITH_SUBTRACT: EMIT(0x48, 0x29, 0xc8); break;
+               default:
+                    EMIT(0x48, 0x0f, 0xaf, 0xc1);         //imul rax, rcx
+                    exit_if(as, CC_O, offset);
+                    EMIT(0x48, 0x85, 0xc0);               //test rax, rax
+                    exit_if(as, CC_E, offset);
+                    break;
+          }
+          exit_unless_int_range(as, offset);
+
+          EMIT(0x48, 0x89, 0x43, (uint8_t)PAYLOAD(SECOND)); //mov [a], rax
+          drop(as, 1);
+          done = emit_jump_to(as, CC_ALWAYS);
+
+          bind(as, not_ints[0]);
+          bind(as, not_ints[1]);
+     }
+
+     load_double(as, 0, SECOND, offset);
+     load_double(as, 1, TOP, offset);
+     switch (op) {
+          case ARITH_ADD:      EMIT(0xf2, 0x0f, 0x58, 0xc1); break;
+          case ARITH_SUBTRACT: EMIT(0xf2, 0x0f, 0x5c, 0xc1); break;
+          case ARITH_MULTIPLY: EMIT(0xf2, 0x0f, 0x59, 0xc1); break;
+          case ARITH_DIVIDE:   EMIT(0xf2, 0x0f, 0x5e, 0xc1); break;
+     }
+     EMIT(0xf2, 0x0f, 0x11, 0x43, (uint8_t)PAYLOAD(SECOND)); //movsd [a], xmm0
+     set_type(as, SECOND, VAL_NUMBER);
+     drop(as, 1);
+
+     if (done != -1) bind(as, done);
+}
+
+static void comparison(assembler* as, bool less, int offset) {
+     check_type(as, SECOND, VAL_INT);
+     int not_int_a = emit_jump_to(as, CC_NE);
+     check_type(as, TOP, VAL_INT);
+     int not_int_b = emit_jump_to(as, CC_NE);
+
+     EMIT(0x48, 0x8b, 0x43, (uint8_t)PAYLOAD(SECOND));    //mov rax, [a]
+     EMIT(0x48, 0x8b, 0x4b, (uint8_t)PAYLOAD(TOP));       //mov rcx, [b]
+     EMIT(0x48, 0x39, 0xc8);                              //cmp rax, rcx
+     EMIT(0x0f, less ? 0x9c : 0x9f, 0xc0);                //setl/setg al
+     int store = emit_jump_to(as, CC_ALWAYS);
+
+     //seta is false for unordered operands, so NaN compares false
+     bind(as, not_int_a);
+     bind(as, not_int_b);
+     load_double(as, 0, SECOND, offset);
+     load_double(as, 1, TOP, offset);
+     EMIT(0x66, 0x0f, 0x2e, less ? 0xc8 : 0xc1);          //ucomisd
+     EMIT(0x0f, 0x97, 0xc0);                              //seta al
+
+     bind(as, store);
+     EMIT(0x0f, 0xb6, 0xc0);                              //movzx eax, al
+     EMIT(0x48, 0x89, 0x43, (uint8_t)PAYLOAD(SECOND));    //mov [a], rax
+     set_type(as, SECOND, VAL_BOOL);
+     drop(as, 1);
+}
+
+//jumps to 'target' when the value on top of the stack is falsey
+static void jump_if_falsey(assembler* as, int target) {
+     check_type(as, TOP, VAL_NULL);
+     jump_if(as, CC_E, target);
+     check_type(as, TOP, VAL_BOOL);
+     int truthy = emit_jump_to(as, CC_NE);
+     EMIT(0x80, 0x7b, (uint8_t)PAYLOAD(TOP), 0x00);       //cmp byte [top], 0
+     jump_if(as, CC_E, target);
+     bind(as, truthy);
+}
+
+static void global_helper(assembler* as, void* helper, obj_string* name,
+                          int disp) {
+     EMIT(0x48, 0xbf);                                    //mov rdi, name
+     emit64(as, (uint64_t)(uintptr_t)name);
+     EMIT(0x48, 0x8d, 0x73, (uint8_t)disp);               //lea rsi, [rbx + d]
+     call_helper(as, helper);
+}
+
+static void exit_if_helper_failed(assembler* as, int offset) {
+     EMIT(0x84, 0xc0);                                    //test al, al
+     exit_if(as, CC_E, offset);
+}
+
+static int instruction(assembler* as, chunk* ch, int offset) {
+     uint8_t* code = ch->code + offset;
+     value* constants = ch->constants.values;
+
+     switch (code[0]) {
+          case OP_CONSTANT:
+               push_value(as, constants[code[1]]);
+               return offset + 2;
+          case OP_CONSTANT_LONG:
+               push_value(as, constants[code[1] | (code[2] << 8) |
+                                        (code[3] << 16)]);
+               return offset + 4;
+          case OP_NULL:  push_value(as, NULL_VAL); return offset + 1;
+          case OP_TRUE:  push_value(as, BOOL_VAL(true)); return offset + 1;
+          case OP_FALSE: push_value(as, BOOL_VAL(false)); return offset + 1;
+          case OP_POP:   drop(as, 1); return offset + 1;
+          case OP_GET_LOCAL:
+               EMIT(0xf3, 0x41, 0x0f, 0x6f, 0x84, 0x24);  //movdqu xmm0, [slot]
+               emit32(as, code[1] * sizeof(value));
+               EMIT(0xf3, 0x0f, 0x7f, 0x03);              //movdqu [rbx], xmm0
+               EMIT(0x48, 0x83, 0xc3, 0x10);              //add rbx, 16
+               return offset + 2;
+          case OP_SET_LOCAL:
+               EMIT(0xf3, 0x0f, 0x6f, 0x43, (uint8_t)TOP);//movdqu xmm0, [top]
+               EMIT(0xf3, 0x41, 0x0f, 0x7f, 0x84, 0x24);  //movdqu [slot], xmm0
+               emit32(as, code[1] * sizeof(value));
+               return offset + 2;
+          case OP_GET_GLOBAL:
+               global_helper(as, jit_get_global, AS_STRING(constants[code[1]]), 0);
+               exit_if_helper_failed(as, offset);
+               EMIT(0x48, 0x83, 0xc3, 0x10);              //add rbx, 16
+               return offset + 2;
+          case OP_DEFINE_GLOBAL:
+               global_helper(as, jit_define_global,
+                             AS_STRING(constants[code[1]]), (uint8_t)TOP);
+               drop(as, 1);
+               return offset + 2;
+          case OP_SET_GLOBAL:
+               global_helper(as, jit_set_global, AS_STRING(constants[code[1]]),
+                             (uint8_t)TOP);
+               exit_if_helper_failed(as, offset);
+               return offset + 2;
+          case OP_EQUAL:
+               EMIT(0x48, 0x8d, 0x7b, (uint8_t)SECOND);   //lea rdi, [a]
+               call_helper(as, jit_equal);
+               EMIT(0x0f, 0xb6, 0xc0);                    //movzx eax, al
+               EMIT(0x48, 0x89, 0x43, (uint8_t)PAYLOAD(SECOND));
+               set_type(as, SECOND, VAL_BOOL);
+               drop(as, 1);
+               return offset + 1;
+          case OP_GREATER:
+          case OP_GREATER_NUM:
+               comparison(as, false, offset);
+               return offset + 1;
+          case OP_LESS:
+          case OP_LESS_NUM:
+               comparison(as, true, offset);
+               return offset + 1;
+          case OP_ADD:
+          case OP_ADD_NUM:
+               arithmetic(as, ARITH_ADD, offset);
+               return offset + 1;
+          case OP_CONCAT:
+               EMIT(0x48, 0x89, 0xdf);                    //mov rdi, rbx
+               EMIT(0xbe); emit32(as, code[1]);           //mov esi, count
+               call_helper(as, jit_concat);
+               EMIT(0x48, 0x85, 0xc0);                    //test rax, rax
+               exit_if(as, CC_E, offset);
+               EMIT(0x48, 0x89, 0xc3);                    //mov rbx, rax
+               return offset + 2;
+          case OP_SUBTRACT:
+          case OP_SUBTRACT_NUM:
+               arithmetic(as, ARITH_SUBTRACT, offset);
+               return offset + 1;
+          case OP_MULTIPLY:
+          case OP_MULTIPLY_NUM:
+               arithmetic(as, ARITH_MULTIPLY, offset);
+               return offset + 1;
+          case OP_DIVIDE:
+          case OP_DIVIDE_NUM:
+               arithmetic(as, ARITH_DIVIDE, offset);
+               return offset + 1;
+          case OP_NOT: {
+               EMIT(0x31, 0xc0);                          //xor eax, eax
+               check_type(as, TOP, VAL_NULL);
+               int is_null = emit_jump_to(as, CC_E);
+               check_type(as, TOP, VAL_BOOL);
+               int truthy = emit_jump_to(as, CC_NE);
+               EMIT(0x80, 0x7b, (uint8_t)PAYLOAD(TOP), 0x00);
+               int is_true = emit_jump_to(as, CC_NE);
+               bind(as, is_null);
+               EMIT(0xb8); emit32(as, 1);                 //mov eax, 1
+               bind(as, truthy);
+               bind(as, is_true);
+               EMIT(0x48, 0x89, 0x43, (uint8_t)PAYLOAD(TOP));
+               set_type(as, TOP, VAL_BOOL);
+               return offset + 1;
+          }
+          case OP_NOT_BOOL:
+               EMIT(0x80, 0x73, (uint8_t)PAYLOAD(TOP), 0x01); //xor byte [top], 1
+               return offset + 1;
+          case OP_NEGATE:
+          case OP_NEGATE_NUM: {
+               //negating integer zero gives -0, which only a double can hold
+               check_type(as, TOP, VAL_INT);
+               int not_int = emit_jump_to(as, CC_NE);
+               EMIT(0x48, 0x83, 0x7b, (uint8_t)PAYLOAD(TOP), 0x00);
+               exit_if(as, CC_E, offset);
+               EMIT(0x48, 0xf7, 0x5b, (uint8_t)PAYLOAD(TOP)); //neg qword [top]
+               int done = emit_jump_to(as, CC_ALWAYS);
+
+               bind(as, not_int);
+               check_type(as, TOP, VAL_NUMBER);
+               exit_if(as, CC_NE, offset);
+               EMIT(0x48, 0x8b, 0x43, (uint8_t)PAYLOAD(TOP)); //mov rax, [top]
+               EMIT(0x48, 0x0f, 0xba, 0xf8, 0x3f);        //btc rax, 63
+               EMIT(0x48, 0x89, 0x43, (uint8_t)PAYLOAD(TOP));
+               bind(as, done);
+               return offset + 1;
+          }
+          case OP_PRINT:
+               EMIT(0x48, 0x8d, 0x7b, (uint8_t)TOP);      //lea rdi, [top]
+               call_helper(as, jit_print);
+               drop(as, 1);
+               return offset + 1;
+          case OP_BUILD_ARRAY:
+               EMIT(0x48, 0x89, 0xdf);                    //mov rdi, rbx
+               EMIT(0xbe); emit32(as, code[1]);           //mov esi, count
+               call_helper(as, jit_build_array);
+               EMIT(0x48, 0x89, 0xc3);                    //mov rbx, rax
+               return offset + 2;
+          case OP_INDEX_GET:
+               EMIT(0x48, 0x89, 0xdf);                    //mov rdi, rbx
+               call_helper(as, jit_index_get);
+               exit_if_helper_failed(as, offset);
+               drop(as, 1);
+               return offset + 1;
+          case OP_INDEX_SET:
+               EMIT(0x48, 0x89, 0xdf);                    //mov rdi, rbx
+               call_helper(as, jit_index_set);
+               exit_if_helper_failed(as, offset);
+               drop(as, 2);
+               return offset + 1;
+          case OP_JUMP: {
+               uint16_t jump = (uint16_t)((code[1] << 8) | code[2]);
+               jump_if(as, CC_ALWAYS, offset + 3 + jump);
+               return offset + 3;
+          }
+          case OP_JUMP_IF_FALSE: {
+               uint16_t jump = (uint16_t)((code[1] << 8) | code[2]);
+               jump_if_falsey(as, offset + 3 + jump);
+               return offset + 3;
+          }
+          case OP_LOOP: {
+               uint16_t jump = (uint16_t)((code[1] << 8) | code[2]);
+               jump_if(as, CC_ALWAYS, offset + 3 - jump);
+               return offset + 3;
+          }
+          case OP_JUMP_IF_LOCAL_NOT_LESS: {
+               value limit = constants[code[2]];
+               uint16_t jump = (uint16_t)((code[3] << 8) | code[4]);
+               if (!IS_INT(limit)) break;
+
+               check_slot_type(as, code[1], VAL_INT);
+               exit_if(as, CC_NE, offset);
+               EMIT(0x49, 0x8b, 0x84, 0x24);              //mov rax, [slot]
+               emit32(as, code[1] * sizeof(value) + 8);
+               EMIT(0x48, 0xb9); emit64(as, AS_INT(limit)); //mov rcx, limit
+               EMIT(0x48, 0x39, 0xc8);                    //cmp rax, rcx
+               jump_if(as, CC_GE, offset + 5 + jump);
+               return offset + 5;
+          }
+          case OP_INCREMENT_LOCAL_LOOP: {
+               value step = constants[code[2]];
+               value limit = constants[code[3]];
+               uint16_t jump = (uint16_t)((code[4] << 8) | code[5]);
+               if (!IS_INT(step) || !IS_INT(limit)) break;
+
+               check_slot_type(as, code[1], VAL_INT);
+               exit_if(as, CC_NE, offset);
+               EMIT(0x49, 0x8b, 0x84, 0x24);              //mov rax, [slot]
+               emit32(as, code[1] * sizeof(value) + 8);
+               EMIT(0x48, 0xb9); emit64(as, AS_INT(step)); //mov rcx, step
+               EMIT(0x48, 0x01, 0xc8);                    //add rax, rcx
+               exit_unless_int_range(as, offset);
+               EMIT(0x49, 0x89, 0x84, 0x24);              //mov [slot], rax
+               emit32(as, code[1] * sizeof(value) + 8);
+               EMIT(0x48, 0xb9); emit64(as, AS_INT(limit)); //mov rcx, limit
+               EMIT(0x48, 0x39, 0xc8);                    //cmp rax, rcx
+               jump_if(as, CC_L, offset + 6 - jump);
+               return offset + 6;
+          }
+          case OP_COUNT:
+               //the counters may have moved since, so load their address
+               EMIT(0x48, 0xb8);                          //mov rax, &counts
+               emit64(as, (uint64_t)(uintptr_t)&coverage.counts);
+               EMIT(0x48, 0x8b, 0x00);                    //mov rax, [rax]
+               EMIT(0x48, 0xff, 0x80);                    //inc qword [rax + line]
+               emit32(as, ch->lines[offset] * sizeof(uint64_t));
+               return offset + 1;
+          default:
+               break;
+     }
+
+     //calls, returns and everything else are left to the interpreter
+     exit_if(as, CC_ALWAYS, offset);
+
+     switch (code[0]) {
+          case OP_CONSTANT_LONG:          return offset + 4;
+          case OP_JUMP_IF_LOCAL_NOT_LESS: return offset + 5;
+          case OP_INCREMENT_LOCAL_LOOP:   return offset + 6;
+          case OP_CALL:
+          case OP_TAIL_CALL:              return offset + 2;
+          default:                        return offset + 1;
+     }
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void free_assembler(assembler* as) {
+     FREE_ARRAY(uint8_t, as->code, as->capacity);
+     FREE_ARRAY(jit_patch, as->jumps, as->jump_capacity);
+     FREE_ARRAY(jit_patch, as->exits, as->exit_capacity);
+}
+
+/*   compiles the whole function up front. the code starts with the entry
+     sequence shared by every instruction and the common exit, followed by
+     the templates in bytecode order and the exit stubs */
+bool jit_compile(obj_function* function) {
+     chunk* ch = &function->chunk;
+     assembler as_storage = { 0 };
+     assembler* as = &as_storage;
+
+     int32_t* entries = ALLOCATE(int32_t, ch->count);
+     for (int i = 0; i < ch->count; i++) entries[i] = -1;
+
+     EMIT(0x53, 0x41, 0x54, 0x41, 0x55);            //push rbx, r12, r13
+     EMIT(0x48, 0x89, 0xfb);                        //mov rbx, rdi
+     EMIT(0x49, 0x89, 0xf4);                        //mov r12, rsi
+     EMIT(0xff, 0xe2);                              //jmp rdx
+
+     int common_exit = as->count;
+     EMIT(0x48, 0xb9);                              //mov rcx, &vm.stack_top
+     emit64(as, (uint64_t)(uintptr_t)&vm.stack_top);
+     EMIT(0x48, 0x89, 0x19);                        //mov [rcx], rbx
+     EMIT(0x41, 0x5d, 0x41, 0x5c, 0x5b);            //pop r13, r12, rbx
+     EMIT(0xc3);                                    //ret
+
+     for (int offset = 0; offset < ch->count;) {
+          entries[offset] = as->count;
+          offset = instruction(as, ch, offset);
+     }
+
+     //one stub per instruction that can be exited at
+     int32_t* stubs = ALLOCATE(int32_t, ch->count);
+     for (int i = 0; i < ch->count; i++) stubs[i] = -1;
+     for (int i = 0; i < as->exit_count; i++) {
+          int target = as->exits[i].target;
+          if (stubs[target] == -1) {
+               stubs[target] = as->count;
+               EMIT(0xb8); emit32(as, target);      //mov eax, offset
+               int at = emit_jump_to(as, CC_ALWAYS);
+               int32_t rel = common_exit - (at + 4);
+               memcpy(as->code + at, &rel, 4);
+          }
+          int32_t rel = stubs[target] - (as->exits[i].at + 4);
+          memcpy(as->code + as->exits[i].at, &rel, 4);
+     }
+     FREE_ARRAY(int32_t, stubs, ch->count);
+
+     for (int i = 0; i < as->jump_count; i++) {
+          int32_t rel = entries[as->jumps[i].target] - (as->jumps[i].at + 4);
+          memcpy(as->code + as->jumps[i].at, &rel, 4);
+     }
+
+     uint8_t* code = mmap(NULL, as->count, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+     if (code == MAP_FAILED) {
+          free_assembler(as);
+          FREE_ARRAY(int32_t, entries, ch->count);
+          return false;
+     }
+     memcpy(code, as->code, as->count);
+
+     /*   a policy against executable mappings refuses every function, so
+          the rest of the program is interpreted instead of trying again at
+          every call */
+     if (mprotect(code, as->count, PROT_READ | PROT_EXEC) != 0) {
+          vm.jit = false;
+          munmap(code, as->count);
+          free_assembler(as);
+          FREE_ARRAY(int32_t, entries, ch->count);
+          return false;
+     }
+
+     jit_code* jit = ALLOCATE(jit_code, 1);
+     jit->code = code;
+     jit->size = as->count;
+     jit->entries = entries;
+     jit->entry_count = ch->count;
+     function->jit = jit;
+
+     free_assembler(as);
+     return true;
+}
+
+//runs the machine code from the frame's ip until it exits at some instruction
+void jit_enter(call_frame* frame) {
+     jit_code* jit = frame->function->jit;
+     uint8_t* start = frame->function->chunk.code;
+     int32_t entry = jit->entries[frame->ip - start];
+     if (entry < 0) return;
+
+     jit_entry_fn run = (jit_entry_fn)(void*)jit->code;
+     uint32_t offset = run(vm.stack_top, frame->slots, jit->code + entry);
+     frame->ip = start + offset;
+}
+
+void jit_free(obj_function* function) {
+     jit_code* jit = function->jit;
+     if (jit == NULL) return;
+
+     munmap(jit->code, jit->size);
+     FREE_ARRAY(int32_t, jit->entries, jit->entry_count);
+     FREE(jit_code, jit);
+     function->jit = NULL;
+}
+
+#else
+
+//other platforms have no JIT and always interpret
+bool jit_compile(obj_function* function) {
+     return false;
+}
+
+void jit_enter(call_frame* frame) {
+}
+
+void jit_free(obj_function* function) {
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef klox_jit_h
+#define klox_jit_h
+
+#include "common.h"
+#include "object.h"
+#include "vm.h"
+
+/*   machine code compiled from a function's bytecode. any instruction can be
+     entered from the interpreter through its entry, and the code hands control
+     back to the interpreter by returning the offset of the instruction it
+     could not run */
+struct s_jit_code {
+     uint8_t* code;           //mmap'd, executable
+     size_t size;
+     int32_t* entries;        //code offset per bytecode offset, -1 if none
+     int entry_count;
+};
+
+bool jit_compile(obj_function* function);
+void jit_enter(call_frame* frame);
+void jit_free(obj_function* function);
+
+#endif
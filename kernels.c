@@ -0,0 +1,185 @@
+#include <math.h>
+#include <string.h>
+
+#include "kernels.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*   the sum and the dot product keep four partial sums, so they may round
+     differently from a left to right loop over the same numbers */
+double kernel_sum(const double* values, int count) {
+     int i = 0;
+     double sum = 0;
+#ifdef __SSE2__
+     __m128d acc0 = _mm_setzero_pd();
+     __m128d acc1 = _mm_setzero_pd();
+     for (; i + 4 <= count; i += 4) {
+          acc0 = _mm_add_pd(acc0, _mm_loadu_pd(values + i));
+          acc1 = _mm_add_pd(acc1, _mm_loadu_pd(values + i + 2));
+     }
+     double lanes[2];
+     _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+     sum = lanes[0] + lanes[1];
+#endif
+     for (; i < count; i++) sum += values[i];
+     return sum;
+}
+
+double kernel_dot(const double* a, const double* b, int count) {
+     int i = 0;
+     double sum = 0;
+#ifdef __SSE2__
+     __m128d acc0 = _mm_setzero_pd();
+     __m128d acc1 = _mm_setzero_pd();
+     for (; i + 4 <= count; i += 4) {
+          acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i),
+                                             _mm_loadu_pd(b + i)));
+          acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2),
+                                             _mm_loadu_pd(b + i + 2)));
+     }
+     double lanes[2];
+     _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+     sum = lanes[0] + lanes[1];
+#endif
+     for (; i < count; i++) sum += a[i] * b[i];
+     return sum;
+}
+
+#ifdef __SSE2__
+static double first_nan(const double* values) {
+     while (!isnan(*values)) values++;
+     return *values;
+}
+#endif
+
+/*   min and max return the first NaN as soon as there is one, whatever its
+     position, like the min() and max() natives given separate numbers.
+     count must be at least 1 */
+double kernel_min(const double* values, int count) {
+     int i = 0;
+     double result = values[0];
+#ifdef __SSE2__
+     if (count >= 2) {
+          __m128d acc = _mm_loadu_pd(values);
+          __m128d nan = _mm_cmpunord_pd(acc, acc);
+          for (i = 2; i + 2 <= count; i += 2) {
+               __m128d next = _mm_loadu_pd(values + i);
+               acc = _mm_min_pd(acc, next);
+               nan = _mm_or_pd(nan, _mm_cmpunord_pd(next, next));
+          }
+          if (_mm_movemask_pd(nan) != 0) return first_nan(values);
+          double lanes[2];
+          _mm_storeu_pd(lanes, acc);
+          result = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+     }
+#endif
+     for (; i < count; i++) {
+          if (isnan(values[i])) return values[i];
+          if (values[i] < result) result = values[i];
+     }
+     return result;
+}
+
+double kernel_max(const double* values, int count) {
+     int i = 0;
+     double result = values[0];
+#ifdef __SSE2__
+     if (count >= 2) {
+          __m128d acc = _mm_loadu_pd(values);
+          __m128d nan = _mm_cmpunord_pd(acc, acc);
+          for (i = 2; i + 2 <= count; i += 2) {
+               __m128d next = _mm_loadu_pd(values + i);
+               acc = _mm_max_pd(acc, next);
+               nan = _mm_or_pd(nan, _mm_cmpunord_pd(next, next));
+          }
+          if (_mm_movemask_pd(nan) != 0) return first_nan(values);
+          double lanes[2];
+          _mm_storeu_pd(lanes, acc);
+          result = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+     }
+#endif
+     for (; i < count; i++) {
+          if (isnan(values[i])) return values[i];
+          if (values[i] > result) result = values[i];
+     }
+     return result;
+}
+
+void kernel_scale(double* values, int count, double factor) {
+     int i = 0;
+#ifdef __SSE2__
+     __m128d f = _mm_set1_pd(factor);
+     for (; i + 2 <= count; i += 2) {
+          _mm_storeu_pd(values + i, _mm_mul_pd(_mm_loadu_pd(values + i), f));
+     }
+#endif
+     for (; i < count; i++) values[i] *= factor;
+}
+
+/*   maps a double to an unsigned key with the same ordering: negative numbers
+     have all their bits flipped, positive ones only the sign bit */
+static inline uint64_t sort_key(double d) {
+     uint64_t bits;
+     memcpy(&bits, &d, sizeof(bits));
+     return (bits >> 63) ? ~bits : bits | (UINT64_C(1) << 63);
+}
+
+static void insertion_sort(double* values, int count) {
+     for (int i = 1; i < count; i++) {
+          double d = values[i];
+          uint64_t key = sort_key(d);
+          int j = i - 1;
+          while (j >= 0 && sort_key(values[j]) > key) {
+               values[j + 1] = values[j];
+               j--;
+          }
+          values[j + 1] = d;
+     }
+}
+
+/*   an ascending LSD radix sort, one byte per pass. all eight histograms are
+     built in a single read, and passes where every key shares the byte are
+     skipped. 'temp' must have room for 'count' doubles */
+void kernel_sort(double* values, double* temp, int count) {
+     if (count < 64) {
+          insertion_sort(values, count);
+          return;
+     }
+
+     static int histogram[8][256];
+     memset(histogram, 0, sizeof(histogram));
+     for (int i = 0; i < count; i++) {
+          uint64_t key = sort_key(values[i]);
+          for (int pass = 0; pass < 8; pass++) {
+               histogram[pass][(key >> (pass * 8)) & 0xff]++;
+          }
+     }
+
+     double* from = values;
+     double* to = temp;
+     for (int pass = 0; pass < 8; pass++) {
+          int* counts = histogram[pass];
+          uint64_t first = (sort_key(from[0]) >> (pass * 8)) & 0xff;
+          if (counts[first] == count) continue;
+
+          int offset = 0;
+          for (int b = 0; b < 256; b++) {
+               int n = counts[b];
+               counts[b] = offset;
+               offset += n;
+          }
+
+          for (int i = 0; i < count; i++) {
+               uint64_t key = sort_key(from[i]);
+               to[counts[(key >> (pass * 8)) & 0xff]++] = from[i];
+          }
+
+          double* swap = from;
+          from = to;
+          to = swap;
+     }
+
+     if (from != values) memcpy(values, from, sizeof(double) * count);
+}
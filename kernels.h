@@ -0,0 +1,16 @@
+#ifndef klox_kernels_h
+#define klox_kernels_h
+
+#include "common.h"
+
+/*   bulk numeric kernels over packed doubles, used by the array natives once
+     the elements have been unboxed. they use SSE2 where it is available and
+     plain loops everywhere else */
+double kernel_sum(const double* values, int count);
+double kernel_min(const double* values, int count);
+double kernel_max(const double* values, int count);
+double kernel_dot(const double* a, const double* b, int count);
+void kernel_scale(double* values, int count, double factor);
+void kernel_sort(double* values, double* temp, int count);
+
+#endif
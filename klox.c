@@ -0,0 +1,86 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "common.h"
+#include "compiler.h"
+#include "jit.h"
+#include "klox.h"
+#include "memory.h"
+#include "object.h"
+#include "table.h"
+#include "vm.h"
+
+struct s_klox_script {
+     obj_function* function;
+};
+
+void klox_init() {
+     init_vm();
+}
+
+void klox_free() {
+     free_vm();
+}
+
+//returns NULL after reporting compile errors
+klox_script* klox_compile(const char* source) {
+     obj_function* function = compile(source);
+     if (function == NULL) return NULL;
+
+     klox_script* script = ALLOCATE(klox_script, 1);
+     script->function = function;
+     return script;
+}
+
+klox_result klox_execute(klox_script* script, klox_globals globals) {
+     if (globals == KLOX_FRESH_GLOBALS) reset_globals();
+     switch (execute(script->function)) {
+          case RESULT_OK:            return KLOX_OK;
+          case RESULT_COMPILE_ERROR: return KLOX_COMPILE_ERROR;
+          case RESULT_RUNTIME_ERROR: break;
+     }
+     return KLOX_RUNTIME_ERROR;
+}
+
+//the function object itself stays on the VM's object list until klox_free
+void klox_free_script(klox_script* script) {
+     free_chunk(&script->function->chunk);
+     jit_free(script->function);
+     FREE(klox_script, script);
+}
+
+//klox_value is value, so a klox_native is a native_fn
+void klox_define_native(const char* name, klox_native function, int arity) {
+     define_native(name, function, arity);
+}
+
+void klox_error(const char* format, ...) {
+     char message[1024];
+     va_list args;
+     va_start(args, format);
+     vsnprintf(message, sizeof(message), format, args);
+     va_end(args);
+     runtime_error("%s", message);
+}
+
+bool klox_arg_number(klox_value* args, int index, double* number) {
+     if (!IS_NUMBER(args[index])) return false;
+     *number = AS_NUMBER(args[index]);
+     return true;
+}
+
+const char* klox_arg_string(klox_value* args, int index) {
+     return IS_STRING(args[index]) ? AS_CSTRING(args[index]) : NULL;
+}
+
+void klox_return_number(klox_value* args, double number) {
+     args[-1] = NUMBER_VAL(number);
+}
+
+void klox_return_bool(klox_value* args, bool boolean) {
+     args[-1] = BOOL_VAL(boolean);
+}
+
+void klox_return_string(klox_value* args, const char* chars, int length) {
+     args[-1] = OBJ_VAL(copy_string(chars, length));
+}
@@ -0,0 +1,65 @@
+#ifndef klox_klox_h
+#define klox_klox_h
+
+#include <stdbool.h>
+
+/*   the embedding API, built into libklox.a and libklox.so with 'make
+     libklox'. this header is all a host needs: everything else in the
+     library is hidden from it. a host compiles a script once and executes
+     the handle as often as it likes, each execution only runs the
+     bytecode. natives the host registers with klox_define_native() after
+     klox_init() are visible to every execution:
+
+          klox_init();
+          klox_script* script = klox_compile(source);
+          for (each request) klox_execute(script, KLOX_FRESH_GLOBALS);
+          klox_free_script(script);
+          klox_free();
+
+     there is no garbage collector, objects a script allocates live until
+     klox_free(). klox_init() installs a SIGSEGV handler for the stack's
+     guard page, a host's own handler has to be installed before it */
+
+#define KLOX_API __attribute__((visibility("default")))
+
+typedef struct s_klox_script klox_script;
+
+typedef enum {
+     KLOX_OK,
+     KLOX_COMPILE_ERROR,
+     KLOX_RUNTIME_ERROR
+} klox_result;
+
+typedef enum {
+     KLOX_FRESH_GLOBALS,      //start from the natives alone
+     KLOX_KEEP_GLOBALS        //see what earlier executions left behind
+} klox_globals;
+
+KLOX_API void klox_init(void);
+KLOX_API void klox_free(void);
+KLOX_API klox_script* klox_compile(const char* source);
+KLOX_API klox_result klox_execute(klox_script* script, klox_globals globals);
+KLOX_API void klox_free_script(klox_script* script);
+
+/*   a native gets its arguments where they sit on the VM stack, reads them
+     with the klox_arg_ functions and sets its result with a klox_return_
+     one. it returns false after reporting a failure with klox_error() */
+typedef struct s_value klox_value;
+typedef bool (*klox_native)(int arg_count, klox_value* args);
+
+#define KLOX_VARIADIC -1
+
+KLOX_API void klox_define_native(const char* name, klox_native function,
+                                 int arity);
+KLOX_API void klox_error(const char* format, ...);
+
+//false, or NULL, when the argument has another type
+KLOX_API bool klox_arg_number(klox_value* args, int index, double* number);
+KLOX_API const char* klox_arg_string(klox_value* args, int index);
+
+KLOX_API void klox_return_number(klox_value* args, double number);
+KLOX_API void klox_return_bool(klox_value* args, bool boolean);
+KLOX_API void klox_return_string(klox_value* args, const char* chars,
+                                 int length);
+
+#endif
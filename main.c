@@ -2,9 +2,17 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "aot.h"
 #include "common.h"
 #include "chunk.h"
+#include "compiler.h"
+#include "coverage.h"
 #include "debug.h"
+#include "forkserver.h"
+#include "perf.h"
+#include "serve.h"
+#include "snapshot.h"
+#include "trace.h"
 #include "vm.h"
 
 static void repl() {
@@ -62,15 +70,205 @@ static void run_file(const char* path) {
     if (res == RESULT_RUNTIME_ERROR) exit(70);
 }
 
+//the script --coverage was given and where its reports go
+static const char* covered_path;
+static const char* covered_prefix;
+
+//runs at exit, so scripts that end in an error are reported as well
+static void report_coverage() {
+    if (!write_coverage(covered_path, covered_prefix)) {
+        fprintf(stderr, "could not write the coverage report.\n");
+    }
+    free_coverage();
+}
+
+//where --perf-counters writes the counts, at exit like the coverage reports
+static const char* counters_path;
+
+/*   a traced run also reports how many instructions it executed, which is
+     what the benchmark runner divides the counts of an untraced run by */
+static void report_perf() {
+    FILE* file = fopen(counters_path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "could not open file \"%s\".\n", counters_path);
+    } else {
+        write_perf(file);
+        if (trace.enabled) {
+            fprintf(file, "opcodes %llu\n", (unsigned long long)trace.count);
+        }
+        fclose(file);
+    }
+    free_perf();
+}
+
+//translates the script to C instead of running it, see aot.h
+static void emit_file(const char* path, const char* out_path) {
+    char* source = read_file(path);
+    obj_function* script = compile(source);
+    free(source);
+    if (script == NULL) exit(65);
+
+    FILE* out = stdout;
+    if (out_path != NULL) {
+        out = fopen(out_path, "w");
+        if (out == NULL) {
+            fprintf(stderr, "could not open file \"%s\".\n", out_path);
+            exit(74);
+        }
+    }
+
+    emit_c(script, out, path);
+    if (out != stdout) fclose(out);
+}
+
+//a size in bytes with an optional k, m or g suffix, 0 when it is malformed
+static size_t parse_size(const char* text) {
+    char* end;
+    unsigned long long size = strtoull(text, &end, 10);
+    if (end == text) return 0;
+    switch (*end) {
+        case 'k': case 'K': size <<= 10; end++; break;
+        case 'm': case 'M': size <<= 20; end++; break;
+        case 'g': case 'G': size <<= 30; end++; break;
+    }
+    return *end == '\0' ? (size_t)size : 0;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: klox [--trace[=count]] [--jit] [--emit-c[=file]]\n"
+                    "            [--stack-size=bytes]\n"
+                    "            [--coverage[=prefix]] [--perf-counters=file]\n"
+                    "            [--image file] [--snapshot file]\n"
+                    "            [--fork-server socket | --connect socket]\n"
+                    "            [--serve socket | --request socket] [path]\n");
+    exit(64);
+}
+
 int main(int argc, const char* argv[]) {
+    const char* path = NULL;
+    int trace_count = 0;
+    bool jit = false;
+    bool emit = false;
+    const char* emit_path = NULL;
+    const char* snapshot_path = NULL;
+    const char* image_path = NULL;
+    const char* server_path = NULL;
+    const char* connect_path = NULL;
+    const char* serve_path = NULL;
+    const char* request_path = NULL;
+    const char* perf_path = NULL;
+    size_t stack_size = 0;
+    bool covered = false;
+    const char* coverage_prefix = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0) {
+            trace_count = TRACE_DUMP_DEFAULT;
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            trace_count = atoi(argv[i] + 8);
+            if (trace_count <= 0) usage();
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            jit = true;
+        } else if (strcmp(argv[i], "--emit-c") == 0) {
+            emit = true;
+        } else if (strncmp(argv[i], "--emit-c=", 9) == 0) {
+            emit = true;
+            emit_path = argv[i] + 9;
+        } else if (strncmp(argv[i], "--stack-size=", 13) == 0) {
+            stack_size = parse_size(argv[i] + 13);
+            if (stack_size == 0) usage();
+        } else if (strncmp(argv[i], "--perf-counters=", 16) == 0) {
+            perf_path = argv[i] + 16;
+        } else if (strcmp(argv[i], "--coverage") == 0) {
+            covered = true;
+        } else if (strncmp(argv[i], "--coverage=", 11) == 0) {
+            covered = true;
+            coverage_prefix = argv[i] + 11;
+        } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            snapshot_path = argv[++i];
+        } else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) {
+            image_path = argv[++i];
+        } else if (strcmp(argv[i], "--fork-server") == 0 && i + 1 < argc) {
+            server_path = argv[++i];
+        } else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+            connect_path = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serve_path = argv[++i];
+        } else if (strcmp(argv[i], "--request") == 0 && i + 1 < argc) {
+            request_path = argv[++i];
+        } else if (argv[i][0] == '-' || path != NULL) {
+            usage();
+        } else {
+            path = argv[i];
+        }
+    }
+
+    //a client only ships the script to a fork server, it needs no VM
+    if (connect_path != NULL) {
+        if (path == NULL) usage();
+        char* source = read_file(path);
+        int status = run_fork_client(connect_path, source);
+        free(source);
+        return status;
+    }
+    if (request_path != NULL) {
+        if (path == NULL) usage();
+        char* source = read_file(path);
+        int status = run_request(request_path, source);
+        free(source);
+        return status;
+    }
+
+    //counts are only reported for a script run the ordinary way
+    if (covered && (server_path != NULL || serve_path != NULL || emit)) usage();
+
+    //before init_vm, whose stack handler passes crashes on to these
+    if (trace_count > 0) install_trace_handlers();
+
     init_vm();
-    if (argc == 1) {
+    vm.jit = jit;
+    if (stack_size > 0 && !set_stack_size(stack_size)) {
+        fprintf(stderr, "could not reserve a stack of %zu bytes.\n", stack_size);
+        exit(74);
+    }
+
+    //start from the heap a prelude left behind instead of an empty one
+    if (image_path != NULL && !load_snapshot(image_path)) exit(74);
+
+    //record every instruction and dump the most recent ones on errors
+    if (trace_count > 0) enable_trace(trace_count);
+
+    if (perf_path != NULL) {
+        counters_path = perf_path;
+        enable_perf();
+        atexit(report_perf);
+    }
+
+    if (server_path != NULL) {
+        //the optional path is a prelude every job starts after
+        if (path != NULL) run_file(path);
+        run_fork_server(server_path);
+        exit(74);
+    } else if (serve_path != NULL) {
+        //requests share one VM, starting from whatever the prelude defined
+        if (path != NULL) run_file(path);
+        run_server(serve_path);
+        exit(74);
+    } else if (emit) {
+        if (path == NULL) usage();
+        emit_file(path, emit_path);
+    } else if (path == NULL) {
+        if (snapshot_path != NULL || covered) usage();
         repl();
-    } else if (argc == 2) {
-        run_file(argv[1]);
     } else {
-        fprintf(stderr, "usage: klox [path]\n");
-        exit(64);
+        if (covered) {
+            covered_path = path;
+            covered_prefix = coverage_prefix != NULL ? coverage_prefix : path;
+            enable_coverage();
+            atexit(report_coverage);
+        }
+        run_file(path);
+        if (snapshot_path != NULL && !save_snapshot(snapshot_path)) exit(74);
     }
     free_vm();
     return 0;
@@ -1,6 +1,8 @@
+#include <stdio.h>
 #include <stdlib.h>
 
 #include "common.h"
+#include "jit.h"
 #include "memory.h"
 #include "vm.h"
 
@@ -13,8 +15,79 @@ void* reallocate(void* previous, size_t old_size, size_t new_size) {
      return realloc(previous, new_size);
 }
 
+#ifdef KLOX_COMPACT_HEAP
+
+arena object_heap;
+
+obj* allocate_in_heap(size_t size) {
+     if (object_heap.base == NULL) {
+          init_arena(&object_heap, HEAP_SIZE);
+          arena_grow(&object_heap, NULL, 0, OBJ_ALIGN);
+     }
+
+     //the header has 28 bits for the size
+     obj* object = NULL;
+     if (size / OBJ_ALIGN < (1u << (32 - OBJ_TYPE_BITS))) {
+          object = arena_grow(&object_heap, NULL, 0, size);
+     }
+     if (object == NULL) {
+          fprintf(stderr, "out of memory for objects.\n");
+          exit(70);
+     }
+     return object;
+}
+
+//objects themselves go when the heap is released, only their buffers here
+static void free_object(obj* object) {
+     switch (obj_type_of(object)) {
+          case OBJ_ARRAY:
+               free_val_array(&((obj_array*)object)->items);
+               break;
+          case OBJ_FUNCTION: {
+               obj_function* function = (obj_function*)object;
+               free_chunk(&function->chunk);
+               jit_free(function);
+               break;
+          }
+          case OBJ_NATIVE:
+          case OBJ_STRING:
+               break;
+     }
+}
+
+void free_objects() {
+     if (object_heap.base == NULL) return;
+
+     size_t offset = OBJ_ALIGN;
+     while (offset < object_heap.used) {
+          obj* object = (obj*)(object_heap.base + offset);
+          offset += obj_size(object);
+          free_object(object);
+     }
+     arena_release(&object_heap, OBJ_ALIGN);
+     trim_arena(&object_heap, 0);
+}
+
+#else
+
 static void free_object(obj* object) {
      switch(object->type) {
+          case OBJ_ARRAY: {
+               obj_array* array = (obj_array*)object;
+               free_val_array(&array->items);
+               FREE(obj_array, object);
+               break;
+          }
+          case OBJ_FUNCTION: {
+               obj_function* function = (obj_function*)object;
+               free_chunk(&function->chunk);
+               jit_free(function);
+               FREE(obj_function, object);
+               break;
+          }
+          case OBJ_NATIVE:
+               FREE(obj_native, object);
+               break;
           case OBJ_STRING: {
                obj_string* string = (obj_string*)object;
                FREE_ARRAY(char, string->chars, string->length + 1);
@@ -32,3 +105,5 @@ void free_objects() {
           object = next;
      }
 }
+
+#endif
@@ -21,4 +21,25 @@
 void* reallocate(void* previous, size_t old_size, size_t new_size);
 void free_objects();
 
+#ifdef KLOX_COMPACT_HEAP
+#include "arena.h"
+
+//address space reserved for objects, 32-bit references reach 8 times as far
+#define HEAP_SIZE ((size_t)4 << 30)
+
+extern arena object_heap;
+
+//'size' bytes of the object heap, a multiple of OBJ_ALIGN. exits when full
+obj* allocate_in_heap(size_t size);
+
+//offset 0 holds no object, so a reference of 0 can stand for NULL
+static inline obj_ref obj_to_ref(obj* object) {
+     return (obj_ref)(((uint8_t*)object - object_heap.base) / OBJ_ALIGN);
+}
+
+static inline obj* ref_to_obj(obj_ref ref) {
+     return (obj*)(object_heap.base + (size_t)ref * OBJ_ALIGN);
+}
+#endif
+
 #endif
@@ -0,0 +1,293 @@
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "common.h"
+#include "kernels.h"
+#include "memory.h"
+#include "natives.h"
+#include "object.h"
+#include "vm.h"
+
+/*   the built-in natives. each one reads its arguments straight off the VM
+     stack and writes its result over the callee in args[-1] */
+
+static bool check_numbers(const char* name, int arg_count, value* args) {
+     for (int i = 0; i < arg_count; i++) {
+          if (!IS_NUMBER(args[i])) {
+               runtime_error("arguments to '%s' must be numbers", name);
+               return false;
+          }
+     }
+     return true;
+}
+
+static bool clock_native(int arg_count, value* args) {
+     args[-1] = NUMBER_VAL((double)clock() / CLOCKS_PER_SEC);
+     return true;
+}
+
+//natives that apply a C math function to a single number
+#define UNARY_NATIVE(name, fn) \
+     static bool name##_native(int arg_count, value* args) { \
+          if (!check_numbers(#name, arg_count, args)) return false; \
+          args[-1] = NUMBER_VAL(fn(AS_NUMBER(args[0]))); \
+          return true; \
+     }
+
+UNARY_NATIVE(sqrt, sqrt)
+UNARY_NATIVE(sin, sin)
+UNARY_NATIVE(cos, cos)
+UNARY_NATIVE(tan, tan)
+UNARY_NATIVE(atan, atan)
+UNARY_NATIVE(exp, exp)
+UNARY_NATIVE(log, log)
+
+#undef UNARY_NATIVE
+
+//rounding natives, integers are already rounded and come back unchanged
+#define ROUNDING_NATIVE(name, fn) \
+     static bool name##_native(int arg_count, value* args) { \
+          if (!check_numbers(#name, arg_count, args)) return false; \
+          args[-1] = IS_INT(args[0]) ? args[0] \
+                                     : NUMBER_VAL(fn(AS_DOUBLE(args[0]))); \
+          return true; \
+     }
+
+ROUNDING_NATIVE(floor, floor)
+ROUNDING_NATIVE(ceil, ceil)
+ROUNDING_NATIVE(round, round)
+
+#undef ROUNDING_NATIVE
+
+static bool abs_native(int arg_count, value* args) {
+     if (!check_numbers("abs", arg_count, args)) return false;
+     if (IS_INT(args[0])) {
+          args[-1] = INT_VAL(llabs(AS_INT(args[0])));
+     } else {
+          args[-1] = NUMBER_VAL(fabs(AS_DOUBLE(args[0])));
+     }
+     return true;
+}
+
+static bool pow_native(int arg_count, value* args) {
+     if (!check_numbers("pow", arg_count, args)) return false;
+     args[-1] = NUMBER_VAL(pow(AS_NUMBER(args[0]), AS_NUMBER(args[1])));
+     return true;
+}
+
+/*   the array natives unbox the elements into a packed buffer of doubles and
+     hand that to the kernels. the buffer is reused from call to call */
+static double* scratch = NULL;
+static int scratch_capacity = 0;
+
+static double* reserve_scratch(int count) {
+     if (scratch_capacity < count) {
+          int old_capacity = scratch_capacity;
+          while (scratch_capacity < count) {
+               scratch_capacity = GROW_CAPACITY(scratch_capacity);
+          }
+          scratch = GROW_ARRAY(scratch, double, old_capacity, scratch_capacity);
+     }
+     return scratch;
+}
+
+static obj_array* check_array(const char* name, value val) {
+     if (!IS_ARRAY(val)) {
+          runtime_error("'%s' expects an array", name);
+          return NULL;
+     }
+     return AS_ARRAY(val);
+}
+
+//copies the elements of 'array' into 'into' as doubles, if they are all numbers
+static bool unbox(const char* name, obj_array* array, double* into) {
+     value* items = array->items.values;
+     for (int i = 0; i < array->items.count; i++) {
+          if (IS_INT(items[i])) {
+               into[i] = (double)AS_INT(items[i]);
+          } else if (IS_DOUBLE(items[i])) {
+               into[i] = AS_DOUBLE(items[i]);
+          } else {
+               runtime_error("'%s' expects an array of numbers", name);
+               return false;
+          }
+     }
+     return true;
+}
+
+//writes the packed doubles back over the elements of 'array'
+static void rebox(obj_array* array, const double* from) {
+     for (int i = 0; i < array->items.count; i++) {
+          array->items.values[i] = NUMBER_VAL(from[i]);
+     }
+}
+
+//min and max of a whole array, which must not be empty
+static bool array_extreme(const char* name, obj_array* array, value* result,
+                          bool max) {
+     int count = array->items.count;
+     if (count == 0) {
+          runtime_error("'%s' of an empty array", name);
+          return false;
+     }
+
+     double* values = reserve_scratch(count);
+     if (!unbox(name, array, values)) return false;
+     *result = NUMBER_VAL(max ? kernel_max(values, count)
+                              : kernel_min(values, count));
+     return true;
+}
+
+/*   min and max take one or more numbers and return the chosen one unchanged,
+     or a single array of numbers. the first NaN among them is the result */
+static bool extreme(const char* name, int arg_count, value* args, bool max) {
+     if (arg_count == 1 && IS_ARRAY(args[0])) {
+          return array_extreme(name, AS_ARRAY(args[0]), &args[-1], max);
+     }
+     if (arg_count == 0) {
+          runtime_error("'%s' expects at least 1 argument", name);
+          return false;
+     }
+     if (!check_numbers(name, arg_count, args)) return false;
+
+     value best = args[0];
+     for (int i = 1; i < arg_count && !isnan(AS_NUMBER(best)); i++) {
+          double candidate = AS_NUMBER(args[i]);
+          if (isnan(candidate) ||
+                    (max ? candidate > AS_NUMBER(best) : candidate < AS_NUMBER(best))) {
+               best = args[i];
+          }
+     }
+     args[-1] = best;
+     return true;
+}
+
+static bool min_native(int arg_count, value* args) {
+     return extreme("min", arg_count, args, false);
+}
+
+static bool max_native(int arg_count, value* args) {
+     return extreme("max", arg_count, args, true);
+}
+
+static bool len_native(int arg_count, value* args) {
+     if (IS_ARRAY(args[0])) {
+          args[-1] = INT_VAL(AS_ARRAY(args[0])->items.count);
+     } else if (IS_STRING(args[0])) {
+          args[-1] = INT_VAL(AS_STRING(args[0])->length);
+     } else {
+          runtime_error("'len' expects an array or a string");
+          return false;
+     }
+     return true;
+}
+
+//appends a value and returns the new length
+static bool push_native(int arg_count, value* args) {
+     obj_array* array = check_array("push", args[0]);
+     if (array == NULL) return false;
+
+     write_val_array(&array->items, args[1]);
+     args[-1] = INT_VAL(array->items.count);
+     return true;
+}
+
+static bool sum_native(int arg_count, value* args) {
+     obj_array* array = check_array("sum", args[0]);
+     if (array == NULL) return false;
+
+     double* values = reserve_scratch(array->items.count);
+     if (!unbox("sum", array, values)) return false;
+     args[-1] = NUMBER_VAL(kernel_sum(values, array->items.count));
+     return true;
+}
+
+static bool dot_native(int arg_count, value* args) {
+     obj_array* a = check_array("dot", args[0]);
+     if (a == NULL) return false;
+     obj_array* b = check_array("dot", args[1]);
+     if (b == NULL) return false;
+
+     int count = a->items.count;
+     if (b->items.count != count) {
+          runtime_error("'dot' expects arrays of the same length");
+          return false;
+     }
+
+     double* values = reserve_scratch(count * 2);
+     if (!unbox("dot", a, values) || !unbox("dot", b, values + count)) {
+          return false;
+     }
+     args[-1] = NUMBER_VAL(kernel_dot(values, values + count, count));
+     return true;
+}
+
+//multiplies every element in place and returns the array
+static bool scale_native(int arg_count, value* args) {
+     obj_array* array = check_array("scale", args[0]);
+     if (array == NULL) return false;
+     if (!check_numbers("scale", 1, &args[1])) return false;
+
+     double* values = reserve_scratch(array->items.count);
+     if (!unbox("scale", array, values)) return false;
+     kernel_scale(values, array->items.count, AS_NUMBER(args[1]));
+     rebox(array, values);
+     args[-1] = args[0];
+     return true;
+}
+
+//sorts the numbers in place into ascending order and returns the array
+static bool sort_native(int arg_count, value* args) {
+     obj_array* array = check_array("sort", args[0]);
+     if (array == NULL) return false;
+
+     int count = array->items.count;
+     double* values = reserve_scratch(count * 2);
+     if (!unbox("sort", array, values)) return false;
+     kernel_sort(values, values + count, count);
+     rebox(array, values);
+     args[-1] = args[0];
+     return true;
+}
+
+static const struct {
+     const char* name;
+     native_fn function;
+     int arity;
+} builtins[] = {
+     { "clock", clock_native, 0 },
+     { "sqrt",  sqrt_native,  1 },
+     { "sin",   sin_native,   1 },
+     { "cos",   cos_native,   1 },
+     { "tan",   tan_native,   1 },
+     { "atan",  atan_native,  1 },
+     { "exp",   exp_native,   1 },
+     { "log",   log_native,   1 },
+     { "floor", floor_native, 1 },
+     { "ceil",  ceil_native,  1 },
+     { "round", round_native, 1 },
+     { "abs",   abs_native,   1 },
+     { "pow",   pow_native,   2 },
+     { "min",   min_native,   NATIVE_VARIADIC },
+     { "max",   max_native,   NATIVE_VARIADIC },
+     { "len",   len_native,   1 },
+     { "push",  push_native,  2 },
+     { "sum",   sum_native,   1 },
+     { "dot",   dot_native,   2 },
+     { "scale", scale_native, 2 },
+     { "sort",  sort_native,  1 },
+};
+
+void free_natives() {
+     FREE_ARRAY(double, scratch, scratch_capacity);
+     scratch = NULL;
+     scratch_capacity = 0;
+}
+
+void define_natives() {
+     for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+          define_native(builtins[i].name, builtins[i].function,
+                        builtins[i].arity);
+     }
+}
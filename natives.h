@@ -0,0 +1,9 @@
+#ifndef klox_natives_h
+#define klox_natives_h
+
+#include "common.h"
+
+void define_natives(void);
+void free_natives(void);
+
+#endif
@@ -0,0 +1,375 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "number.h"
+
+//number of significant digits printf("%g") uses by default
+#define SIG_DIGITS 6
+#define SIG_LIMIT  1000000
+#define SIG_FLOOR  100000
+
+static const uint64_t powers_of_ten[] = {
+     1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+     10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+     100000000000ull, 1000000000000ull, 10000000000000ull,
+     100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+     100000000000000000ull, 1000000000000000000ull,
+     10000000000000000000ull,
+};
+
+//largest integer every double below it can represent exactly
+#define EXACT_INT_LIMIT (1ull << 53)
+
+//a u64 holds any 19 digit decimal
+#define MAX_FAST_DIGITS 19
+
+//digits after the point beyond this go through strtod()
+#define MAX_FRACTION_DIGITS 64
+
+/*   floor(2^b / 5^n) for n in [0, 64], normalized so the top bit is set, as
+     high and low 64-bit halves. b is 127 for n = 0 and 128 + floor(n log2 5)
+     otherwise. this is the table the Eisel-Lemire algorithm multiplies by */
+static const uint64_t inverse_powers_of_five[][2] = {
+     { 0x8000000000000000ull, 0x0000000000000000ull },
+     { 0xccccccccccccccccull, 0xccccccccccccccccull },
+     { 0xa3d70a3d70a3d70aull, 0x3d70a3d70a3d70a3ull },
+     { 0x83126e978d4fdf3bull, 0x645a1cac083126e9ull },
+     { 0xd1b71758e219652bull, 0xd3c36113404ea4a8ull },
+     { 0xa7c5ac471b478423ull, 0x0fcf80dc33721d53ull },
+     { 0x8637bd05af6c69b5ull, 0xa63f9a49c2c1b10full },
+     { 0xd6bf94d5e57a42bcull, 0x3d32907604691b4cull },
+     { 0xabcc77118461cefcull, 0xfdc20d2b36ba7c3dull },
+     { 0x89705f4136b4a597ull, 0x31680a88f8953030ull },
+     { 0xdbe6fecebdedd5beull, 0xb573440e5a884d1bull },
+     { 0xafebff0bcb24aafeull, 0xf78f69a51539d748ull },
+     { 0x8cbccc096f5088cbull, 0xf93f87b7442e45d3ull },
+     { 0xe12e13424bb40e13ull, 0x2865a5f206b06fb9ull },
+     { 0xb424dc35095cd80full, 0x538484c19ef38c94ull },
+     { 0x901d7cf73ab0acd9ull, 0x0f9d37014bf60a10ull },
+     { 0xe69594bec44de15bull, 0x4c2ebe687989a9b3ull },
+     { 0xb877aa3236a4b449ull, 0x09befeb9fad487c2ull },
+     { 0x9392ee8e921d5d07ull, 0x3aff322e62439fcfull },
+     { 0xec1e4a7db69561a5ull, 0x2b31e9e3d06c32e5ull },
+     { 0xbce5086492111aeaull, 0x88f4bb1ca6bcf584ull },
+     { 0x971da05074da7beeull, 0xd3f6fc16ebca5e03ull },
+     { 0xf1c90080baf72cb1ull, 0x5324c68b12dd6338ull },
+     { 0xc16d9a0095928a27ull, 0x75b7053c0f178293ull },
+     { 0x9abe14cd44753b52ull, 0xc4926a9672793542ull },
+     { 0xf79687aed3eec551ull, 0x3a83ddbd83f52204ull },
+     { 0xc612062576589ddaull, 0x95364afe032a819dull },
+     { 0x9e74d1b791e07e48ull, 0x775ea264cf55347dull },
+     { 0xfd87b5f28300ca0dull, 0x8bca9d6e188853fcull },
+     { 0xcad2f7f5359a3b3eull, 0x096ee45813a04330ull },
+     { 0xa2425ff75e14fc31ull, 0xa1258379a94d028dull },
+     { 0x81ceb32c4b43fcf4ull, 0x80eacf948770ced7ull },
+     { 0xcfb11ead453994baull, 0x67de18eda5814af2ull },
+     { 0xa6274bbdd0fadd61ull, 0xecb1ad8aeacdd58eull },
+     { 0x84ec3c97da624ab4ull, 0xbd5af13bef0b113eull },
+     { 0xd4ad2dbfc3d07787ull, 0x955e4ec64b44e864ull },
+     { 0xaa242499697392d2ull, 0xdde50bd1d5d0b9e9ull },
+     { 0x881cea14545c7575ull, 0x7e50d64177da2e54ull },
+     { 0xd9c7dced53c72255ull, 0x96e7bd358c904a21ull },
+     { 0xae397d8aa96c1b77ull, 0xabec975e0a0d081aull },
+     { 0x8b61313bbabce2c6ull, 0x2323ac4b3b3da015ull },
+     { 0xdf01e85f912e37a3ull, 0x6b6c46dec52f6688ull },
+     { 0xb267ed1940f1c61cull, 0x55f038b237591ed3ull },
+     { 0x8eb98a7a9a5b04e3ull, 0x77f3608e92adb242ull },
+     { 0xe45c10c42a2b3b05ull, 0x8cb89a7db77c506aull },
+     { 0xb6b00d69bb55c8d1ull, 0x3d607b97c5fd0d22ull },
+     { 0x9226712162ab070dull, 0xcab3961304ca70e8ull },
+     { 0xe9d71b689dde71afull, 0xaab8f01e6e10b4a6ull },
+     { 0xbb127c53b17ec159ull, 0x5560c018580d5d52ull },
+     { 0x95a8637627989aadull, 0xdde7001379a44aa8ull },
+     { 0xef73d256a5c0f77cull, 0x963e66858f6d4440ull },
+     { 0xbf8fdb78849a5f96ull, 0xde98520472bdd033ull },
+     { 0x993fe2c6d07b7fabull, 0xe546a8038efe4029ull },
+     { 0xf53304714d9265dfull, 0xd53dd99f4b3066a8ull },
+     { 0xc428d05aa4751e4cull, 0xaa97e14c3c26b886ull },
+     { 0x9ced737bb6c4183dull, 0x55464dd69685606bull },
+     { 0xfb158592be068d2eull, 0xeed6e2f0f0d56712ull },
+     { 0xc8de047564d20a8bull, 0xf245825a5a445275ull },
+     { 0xa0b19d2ab70e6ed6ull, 0x5b6aceaeae9d0ec4ull },
+     { 0x808e17555f3ebf11ull, 0xe2bbd88bbee40bd0ull },
+     { 0xcdb02555653131b6ull, 0x3792f412cb06794dull },
+     { 0xa48ceaaab75a8e2bull, 0x5fa8c3423c052dd7ull },
+     { 0x83a3eeeef9153e89ull, 0x1953cf68300424acull },
+     { 0xd29fe4b18e88640eull, 0x8eec7f0d19a03aadull },
+     { 0xa87fea27a539e9a5ull, 0x3f2398d747b36224ull },
+};
+
+//bits needed to hold 10^k, an upper bound is enough here
+static int pow10_bits(int k) {
+     return (k * 217707 >> 16) + 1;
+}
+
+//powers of ten a double represents exactly
+static const double exact_powers_of_ten[] = {
+     1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static int write_uint(char* out, uint32_t n) {
+     char digits[10];
+     int count = 0;
+     do {
+          digits[count++] = (char)('0' + n % 10);
+          n /= 10;
+     } while (n != 0);
+
+     for (int i = 0; i < count; i++) out[i] = digits[count - 1 - i];
+     out[count] = '\0';
+     return count;
+}
+
+/*   rounds a positive, finite double to SIG_DIGITS significant digits exactly
+     the way printf does (round half to even on exact ties), producing digits
+     in [SIG_FLOOR, SIG_LIMIT) and the decimal exponent of the leading digit.
+     the double is m * 2^e, so this divides two integers built from m, e and a
+     power of ten. returns false when those do not fit in 128 bits, which only
+     happens for very large or very small magnitudes */
+static bool round_digits(double number, uint32_t* digits, int* exponent) {
+     uint64_t bits;
+     memcpy(&bits, &number, sizeof(bits));
+
+     int biased = (int)((bits >> 52) & 0x7ff);
+     uint64_t m = bits & ((1ull << 52) - 1);
+     int e;
+     if (biased == 0) {
+          e = -1074;
+     } else {
+          m |= 1ull << 52;
+          e = biased - 1075;
+     }
+
+     //number lies in [2^(top), 2^(top + 1)), so this is floor(log10) or one less
+     int top = 63 - __builtin_clzll(m) + e;
+     int x = (top * 78913) >> 18;
+
+     for (;;) {
+          int p = SIG_DIGITS - 1 - x;
+          if (p >= 20 || p <= -20) return false;
+          int num_bits = 64 + (e > 0 ? e : 0) + (p > 0 ? pow10_bits(p) : 0);
+          int den_bits = (e < 0 ? -e : 0) + (p < 0 ? pow10_bits(-p) : 0);
+          if (num_bits > 126 || den_bits > 126) return false;
+
+          unsigned __int128 num = m;
+          if (e > 0) num <<= e;
+          if (p > 0) num *= powers_of_ten[p];
+
+          unsigned __int128 den, quotient, remainder;
+          if (p >= 0) {
+               //the divisor is a power of two, so shifts do the division
+               int shift = e < 0 ? -e : 0;
+               den = (unsigned __int128)1 << shift;
+               quotient = num >> shift;
+               remainder = num & (den - 1);
+          } else {
+               den = powers_of_ten[-p];
+               if (e < 0) den <<= -e;
+               quotient = num / den;
+               remainder = num % den;
+          }
+
+          if (quotient >= SIG_LIMIT) {
+               x++;
+               continue;
+          }
+
+          unsigned __int128 twice = remainder << 1;
+          if (twice > den || (twice == den && (quotient & 1))) quotient++;
+
+          if (quotient == SIG_LIMIT) {
+               quotient = SIG_FLOOR;
+               x++;
+          }
+
+          *digits = (uint32_t)quotient;
+          *exponent = x;
+          return true;
+     }
+}
+
+/*   writes the number the same way printf("%g") does and returns the length.
+     small integers, by far the most common case, are written directly and
+     everything else is rounded with integer arithmetic instead of going
+     through printf's format parsing and its arbitrary precision code */
+int format_number(double number, char* buffer) {
+     char* out = buffer;
+
+     if (isnan(number)) {
+          return sprintf(buffer, signbit(number) ? "-nan" : "nan");
+     }
+
+     if (signbit(number)) {
+          *out++ = '-';
+          number = -number;
+     }
+
+     if (isinf(number)) {
+          memcpy(out, "inf", 4);
+          return (int)(out - buffer) + 3;
+     }
+
+     if (number == 0) {
+          memcpy(out, "0", 2);
+          return (int)(out - buffer) + 1;
+     }
+
+     if (number < SIG_LIMIT && number == (double)(uint32_t)number) {
+          return (int)(out - buffer) + write_uint(out, (uint32_t)number);
+     }
+
+     uint32_t digits;
+     int exponent;
+     if (!round_digits(number, &digits, &exponent)) {
+          return (int)(out - buffer) +
+                 snprintf(out, NUMBER_BUFFER_SIZE - 1, "%g", number);
+     }
+
+     char text[SIG_DIGITS];
+     //the leading digit is never 0, the bound only tells the compiler so
+     int count = SIG_DIGITS;
+     while (count > 1 && digits % 10 == 0) {
+          digits /= 10;
+          count--;
+     }
+     for (int i = count - 1; i >= 0; i--) {
+          text[i] = (char)('0' + digits % 10);
+          digits /= 10;
+     }
+
+     if (exponent < -4 || exponent >= SIG_DIGITS) {
+          *out++ = text[0];
+          if (count > 1) {
+               *out++ = '.';
+               memcpy(out, text + 1, count - 1);
+               out += count - 1;
+          }
+
+          *out++ = 'e';
+          *out++ = exponent < 0 ? '-' : '+';
+          int magnitude = exponent < 0 ? -exponent : exponent;
+          if (magnitude < 10) *out++ = '0';
+          out += write_uint(out, (uint32_t)magnitude);
+          return (int)(out - buffer);
+     }
+
+     if (exponent < 0) {
+          *out++ = '0';
+          *out++ = '.';
+          for (int i = -1; i > exponent; i--) *out++ = '0';
+          memcpy(out, text, count);
+          out += count;
+     } else {
+          int whole = exponent + 1;
+          for (int i = 0; i < whole; i++) *out++ = i < count ? text[i] : '0';
+          if (count > whole) {
+               *out++ = '.';
+               memcpy(out, text + whole, count - whole);
+               out += count - whole;
+          }
+     }
+
+     *out = '\0';
+     return (int)(out - buffer);
+}
+
+/*   converts w * 10^-n to the nearest double, the way Eisel and Lemire do: w
+     is multiplied by a 128-bit approximation of 5^-n and the top 54 bits of
+     the 192-bit product give the mantissa and the rounding bit. the table
+     entry is truncated, so the true product lies in [product, product + w).
+     returns false if that error could change the rounding, or if the result
+     would be subnormal, in which case the caller falls back to strtod() */
+static bool eisel_lemire(uint64_t w, int n, double* result) {
+     int lz = __builtin_clzll(w);
+     w <<= lz;
+
+     const uint64_t* entry = inverse_powers_of_five[n];
+     unsigned __int128 low = (unsigned __int128)w * entry[1];
+     unsigned __int128 high = (unsigned __int128)w * entry[0] +
+                              (uint64_t)(low >> 64);
+     uint64_t p2 = (uint64_t)(high >> 64);
+     uint64_t p1 = (uint64_t)high;
+     uint64_t p0 = (uint64_t)low;
+
+     //the product is in [2^190, 2^192), find where its top bit is
+     int upper = (int)(p2 >> 63);
+     int shift = 10 + upper;
+     uint64_t below_mask = (1ull << (shift - 1)) - 1;
+     uint64_t below = p2 & below_mask;
+
+     //adding the error could carry into the rounding bit
+     if (below == below_mask && p1 == UINT64_MAX) return false;
+     //exactly halfway or exact, leave the tie breaking to strtod()
+     if (below == 0 && p1 == 0 && p0 == 0) return false;
+
+     uint64_t mantissa = p2 >> shift;
+     uint64_t round = (p2 >> (shift - 1)) & 1;
+
+     int b = n == 0 ? 127 : 128 + ((n * 152170) >> 16);
+     int exponent = 190 + upper - lz - b - n;
+
+     mantissa += round;
+     if (mantissa == (1ull << 53)) {
+          mantissa >>= 1;
+          exponent++;
+     }
+
+     int biased = exponent + 1023;
+     if (biased <= 0 || biased >= 0x7ff) return false;
+
+     uint64_t bits = ((uint64_t)biased << 52) | (mantissa & ((1ull << 52) - 1));
+     memcpy(result, &bits, sizeof(bits));
+     return true;
+}
+
+/*   parses a number literal the scanner has already validated, digits with an
+     optional fractional part, and returns exactly what strtod() would. integer
+     literals below 2^53 are converted directly, short decimals take Clinger's
+     path (one exact division), the rest go through Eisel-Lemire and only the
+     rare ambiguous cases reach strtod() */
+double parse_number(const char* start, int length) {
+     const char* end = start + length;
+     const char* c = start;
+
+     uint64_t w = 0;
+     int digits = 0;
+     int fraction = 0;
+
+     //leading zeros carry no information
+     while (c < end && *c == '0') c++;
+
+     for (; c < end && *c != '.'; c++) {
+          if (digits == MAX_FAST_DIGITS) return strtod(start, NULL);
+          w = w * 10 + (uint64_t)(*c - '0');
+          digits++;
+     }
+
+     if (c < end) {
+          const char* last = end - 1;
+          while (last > c && *last == '0') last--;
+
+          for (c++; c <= last; c++) {
+               if (digits == MAX_FAST_DIGITS) return strtod(start, NULL);
+               if (w != 0 || *c != '0') digits++;
+               w = w * 10 + (uint64_t)(*c - '0');
+               fraction++;
+          }
+     }
+
+     if (w == 0) return 0.0;
+
+     if (w <= EXACT_INT_LIMIT) {
+          if (fraction == 0) return (double)w;
+          if (fraction <= 22) return (double)w / (double)exact_powers_of_ten[fraction];
+     }
+
+     double result;
+     if (fraction <= MAX_FRACTION_DIGITS && eisel_lemire(w, fraction, &result)) {
+          return result;
+     }
+
+     return strtod(start, NULL);
+}
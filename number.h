@@ -0,0 +1,12 @@
+#ifndef klox_number_h
+#define klox_number_h
+
+#include "common.h"
+
+//large enough for anything format_number() writes, including the terminator
+#define NUMBER_BUFFER_SIZE 32
+
+int format_number(double number, char* buffer);
+double parse_number(const char* start, int length);
+
+#endif
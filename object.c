@@ -3,6 +3,7 @@
 
 #include "memory.h"
 #include "object.h"
+#include "output.h"
 #include "table.h" 
 #include "value.h"
 #include "vm.h"
@@ -10,6 +11,17 @@
 #define ALLOCATE_OBJ(type, object_type) \
      (type*)allocate_object(sizeof(type), object_type)
 
+#ifdef KLOX_COMPACT_HEAP
+
+static obj* allocate_object(size_t size, obj_type type) {
+     size = (size + OBJ_ALIGN - 1) & ~(size_t)(OBJ_ALIGN - 1);
+     obj* object = allocate_in_heap(size);
+     object->header = (uint32_t)(size / OBJ_ALIGN) << OBJ_TYPE_BITS | type;
+     return object;
+}
+
+#else
+
 /*   allocates memory on the heap for a given object and adds it to the linked
      list of objects for keeping track of refrences */
 static obj* allocate_object(size_t size, obj_type type) {
@@ -20,12 +32,60 @@ static obj* allocate_object(size_t size, obj_type type) {
      return object;
 }
 
+#endif
+
+obj_array* new_array() {
+     obj_array* array = ALLOCATE_OBJ(obj_array, OBJ_ARRAY);
+     init_val_array(&array->items);
+     return array;
+}
+
+obj_function* new_function() {
+     obj_function* function = ALLOCATE_OBJ(obj_function, OBJ_FUNCTION);
+     function->arity = 0;
+     function->name = NULL;
+     function->jit = NULL;
+     function->aot = NULL;
+     init_chunk(&function->chunk);
+     return function;
+}
+
+obj_native* new_native(native_fn function, int arity) {
+     obj_native* native = ALLOCATE_OBJ(obj_native, OBJ_NATIVE);
+     native->function = function;
+     native->arity = arity;
+     return native;
+}
+
+#ifdef KLOX_COMPACT_HEAP
+
+//the characters are copied in after the header, 'chars' stays the caller's
+static obj_string* make_string(const char* chars, int length, uint32_t hash,
+                               bool interned) {
+     obj_string* string = (obj_string*)allocate_object(
+          sizeof(obj_string) + length + 1, OBJ_STRING);
+     string->length = length;
+     string->hash = hash;
+     string->interned = interned;
+     memcpy(string->chars, chars, length);
+     string->chars[length] = '\0';
+     return string;
+}
+
+#endif
+
 //allocates an obj_string on the heap and returns a pointer to that object
 static obj_string* allocate_string(char* chars, int length, uint32_t hash) {
+#ifdef KLOX_COMPACT_HEAP
+     obj_string* string = make_string(chars, length, hash, true);
+     FREE_ARRAY(char, chars, length + 1);
+#else
      obj_string* string = ALLOCATE_OBJ(obj_string, OBJ_STRING);
      string->length = length;
      string->chars = chars;
      string->hash = hash;
+     string->interned = true;
+#endif
 
      table_set(&vm.strings, string, NULL_VAL);
 
@@ -64,17 +124,86 @@ obj_string* copy_string(const char* chars, int length) {
 
      if (interned != NULL) return interned;
 
+#ifdef KLOX_COMPACT_HEAP
+     obj_string* string = make_string(chars, length, hash, true);
+     table_set(&vm.strings, string, NULL_VAL);
+     return string;
+#else
      char* heap = ALLOCATE(char, length + 1);
      memcpy(heap, chars, length);
      heap[length] = '\0';
 
      return allocate_string(heap, length, hash);
+#endif
 }
 
-void print_object(value val) {
+//takes ownership of 'chars' like take_string, without interning the result
+obj_string* new_string(char* chars, int length) {
+#ifdef KLOX_COMPACT_HEAP
+     obj_string* string = make_string(chars, length, 0, false);
+     FREE_ARRAY(char, chars, length + 1);
+#else
+     obj_string* string = ALLOCATE_OBJ(obj_string, OBJ_STRING);
+     string->length = length;
+     string->chars = chars;
+     string->hash = 0;
+     string->interned = false;
+#endif
+     return string;
+}
+
+/*   equality for strings where at least one is not interned. the hash is
+     computed once per string, the first time it is compared */
+bool strings_equal(obj_string* a, obj_string* b) {
+     if (a == b) return true;
+     if (a->length != b->length) return false;
+     if (a->hash == 0) a->hash = hash_string(a->chars, a->length);
+     if (b->hash == 0) b->hash = hash_string(b->chars, b->length);
+     return a->hash == b->hash && memcmp(a->chars, b->chars, a->length) == 0;
+}
+
+static void write_array(out_buffer* out, obj_array* array) {
+     //arrays can contain themselves, so stop descending at some point
+     static int depth = 0;
+     if (depth == 16) {
+          write_chars(out, "[...]", 5);
+          return;
+     }
+
+     depth++;
+     write_char(out, '[');
+     for (int i = 0; i < array->items.count; i++) {
+          if (i > 0) write_chars(out, ", ", 2);
+          write_value(out, array->items.values[i]);
+     }
+     write_char(out, ']');
+     depth--;
+}
+
+static void write_function(out_buffer* out, obj_function* function) {
+     if (function->name == NULL) {
+          write_chars(out, "<script>", 8);
+          return;
+     }
+
+     write_chars(out, "<fn ", 4);
+     write_chars(out, function->name->chars, function->name->length);
+     write_char(out, '>');
+}
+
+void write_object(out_buffer* out, value val) {
      switch (OBJ_TYPE(val)) {
+          case OBJ_ARRAY:
+               write_array(out, AS_ARRAY(val));
+               break;
+          case OBJ_FUNCTION:
+               write_function(out, AS_FUNCTION(val));
+               break;
+          case OBJ_NATIVE:
+               write_chars(out, "<native fn>", 11);
+               break;
           case OBJ_STRING:
-               printf("%s", AS_CSTRING(val));
+               write_chars(out, AS_CSTRING(val), AS_STRING(val)->length);
                break;
      }
 }
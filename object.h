@@ -2,14 +2,33 @@
 #define klox_object_h
 
 #include "common.h"
+#include "chunk.h"
 #include "value.h"
 
 //helper macro to get the type of a ovject value
-#define OBJ_TYPE(val)         (AS_OBJ(val)->type)
+#define OBJ_TYPE(val)         obj_type_of(AS_OBJ(val))
+
+//verifies that the given value is actually an array
+#define IS_ARRAY(val)         is_obj_type(val, OBJ_ARRAY)
+
+//verifies that the given value is actually a function
+#define IS_FUNCTION(val)      is_obj_type(val, OBJ_FUNCTION)
+
+//verifies that the given value is actually a native function
+#define IS_NATIVE(val)        is_obj_type(val, OBJ_NATIVE)
 
 //verifies that the given value is actually a string
 #define IS_STRING(val)        is_obj_type(val, OBJ_STRING)
 
+//unwrap the given klox object into a klox array object
+#define AS_ARRAY(val)         ((obj_array*)AS_OBJ(val))
+
+//unwrap the given klox object into a klox function object
+#define AS_FUNCTION(val)      ((obj_function*)AS_OBJ(val))
+
+//unwrap the given klox object into a klox native function object
+#define AS_NATIVE(val)        ((obj_native*)AS_OBJ(val))
+
 //unwrap the given klox object into a klox string object
 #define AS_STRING(val)        ((obj_string*)AS_OBJ(val))
 
@@ -17,29 +36,118 @@
 #define AS_CSTRING(val)       (((obj_string*)AS_OBJ(val))->chars)
 
 typedef enum {
+     OBJ_ARRAY,
+     OBJ_FUNCTION,
+     OBJ_NATIVE,
      OBJ_STRING,
 } obj_type;
 
+#ifdef KLOX_COMPACT_HEAP
+
+/*   the compact heap. objects are bump allocated, 8-byte aligned, from one
+     region reserved up front and never move. the header packs the type into
+     its low 4 bits and the object's size in 8-byte units into the rest, which
+     is all it takes to walk the region from one object to the next, so there
+     is no list of objects. inside the heap an object can be named by a 32-bit
+     reference, its offset in 8-byte units */
+#define OBJ_ALIGN 8
+#define OBJ_TYPE_BITS 4
+
+struct s_obj {
+     uint32_t header;
+};
+
+typedef uint32_t obj_ref;
+
+static inline obj_type obj_type_of(obj* object) {
+     return (obj_type)(object->header & ((1u << OBJ_TYPE_BITS) - 1));
+}
+
+static inline size_t obj_size(obj* object) {
+     return (size_t)(object->header >> OBJ_TYPE_BITS) * OBJ_ALIGN;
+}
+
+#else
+
 //a sort of abstract base struct for our different type of objects
 struct s_obj {
      obj_type type;
      struct s_obj* next;
 };
 
+static inline obj_type obj_type_of(obj* object) {
+     return object->type;
+}
+
+#endif
+
+//a growable array, its elements live in one contiguous buffer
+typedef struct {
+     obj object;
+     val_array items;
+} obj_array;
+
+//machine code for a function, see jit.h
+typedef struct s_jit_code jit_code;
+
+//a compiled function, which owns the chunk its body was compiled into
+typedef struct {
+     obj object;
+     int arity;
+     chunk chunk;
+     obj_string* name;        //NULL for the top-level script
+     jit_code* jit;           //NULL until the function is compiled with --jit
+     void (*aot)(void);       //its translation to C in an AOT program, see aot.h
+} obj_function;
+
+/*   a function implemented in C. it is handed a pointer to its arguments right
+     where they sit on the VM stack, and stores its result in args[-1], the slot
+     that held the callee. it returns false after reporting a runtime error */
+typedef bool (*native_fn)(int arg_count, value* args);
+
+#define NATIVE_VARIADIC -1
+
+typedef struct {
+     obj object;
+     int arity;               //NATIVE_VARIADIC to accept any number of arguments
+     native_fn function;
+} obj_native;
+
+/*   strings from source code (constants, names) are interned, so there is
+     only one of each and they compare by pointer. long strings made at
+     runtime are not, most of them are printed once and never compared, so
+     they skip hashing all of their characters and growing the intern table.
+     short ones still are: that is cheap, and with no collector an earlier
+     equal string is the only way a repeated result costs no memory.
+     everything that keys a table must be interned */
+#define INTERN_MAX_LENGTH 32
+
 struct s_obj_string {
      obj object;
      int length;
+#ifdef KLOX_COMPACT_HEAP
+     uint32_t hash;           //0 until computed for a string not interned
+     bool interned;
+     char chars[];            //inline and NUL terminated, there is no buffer
+#else
      char* chars;
-     uint32_t hash;
+     uint32_t hash;           //0 until computed for a string not interned
+     bool interned;
+#endif
 };
 
+obj_array* new_array();
+obj_function* new_function();
+obj_native* new_native(native_fn function, int arity);
 obj_string* take_string(char* chars, int length);
 obj_string* copy_string(const char* chars, int length);
-void print_object(value val);
+obj_string* new_string(char* chars, int length);
+bool strings_equal(obj_string* a, obj_string* b);
+void write_object(out_buffer* out, value val);
 
 //verifies that the given value is actually of the given type
 static inline bool is_obj_type(value val, obj_type type) {
-     return IS_OBJ(val) && AS_OBJ(val)->type == type;
+     return IS_OBJ(val) && obj_type_of(AS_OBJ(val)) == type;
 }
 
 #endif
@@ -0,0 +1,47 @@
+#include <string.h>
+
+#include "memory.h"
+#include "output.h"
+
+void init_output(out_buffer* out, FILE* file) {
+     out->chars = NULL;
+     out->count = 0;
+     out->capacity = 0;
+     out->file = file;
+}
+
+void free_output(out_buffer* out) {
+     flush_output(out);
+     FREE_ARRAY(char, out->chars, out->capacity);
+     init_output(out, out->file);
+}
+
+//hands everything buffered so far to the underlying stream
+void flush_output(out_buffer* out) {
+     if (out->count > 0) {
+          fwrite(out->chars, 1, out->count, out->file);
+          out->count = 0;
+     }
+     fflush(out->file);
+}
+
+void write_chars(out_buffer* out, const char* chars, int length) {
+     //the buffer is only allocated once something is actually printed
+     if (out->capacity == 0) {
+          out->chars = ALLOCATE(char, OUTPUT_BUFFER_SIZE);
+          out->capacity = OUTPUT_BUFFER_SIZE;
+     }
+
+     if (length > out->capacity - out->count) {
+          flush_output(out);
+
+          //anything that would not fit even in an empty buffer goes straight out
+          if (length >= out->capacity) {
+               fwrite(chars, 1, length, out->file);
+               return;
+          }
+     }
+
+     memcpy(out->chars + out->count, chars, length);
+     out->count += length;
+}
@@ -0,0 +1,34 @@
+#ifndef klox_output_h
+#define klox_output_h
+
+#include <stdio.h>
+
+#include "common.h"
+#include "value.h"
+
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+/*   an output buffer in front of a stdio stream. everything a script prints
+     is collected here and handed to the stream in large blocks at explicit
+     flush points, instead of paying for printf and stream locking per value */
+struct s_out_buffer {
+     char* chars;
+     int count;
+     int capacity;
+     FILE* file;
+};
+
+void init_output(out_buffer* out, FILE* file);
+void free_output(out_buffer* out);
+void flush_output(out_buffer* out);
+void write_chars(out_buffer* out, const char* chars, int length);
+
+static inline void write_char(out_buffer* out, char c) {
+     if (out->count < out->capacity) {
+          out->chars[out->count++] = c;
+     } else {
+          write_chars(out, &c, 1);
+     }
+}
+
+#endif
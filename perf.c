@@ -0,0 +1,81 @@
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "perf.h"
+
+perf_counters perf;
+
+static const char* counter_names[PERF_COUNTER_COUNT] = {
+     [PERF_CYCLES] = "cycles",
+     [PERF_INSTRUCTIONS] = "instructions",
+     [PERF_BRANCH_MISSES] = "branch-misses",
+     [PERF_L1D_MISSES] = "l1d-misses",
+     [PERF_LLC_MISSES] = "llc-misses",
+};
+
+static int open_counter(uint32_t type, uint64_t config) {
+     struct perf_event_attr attr;
+     memset(&attr, 0, sizeof(attr));
+     attr.size = sizeof(attr);
+     attr.type = type;
+     attr.config = config;
+     attr.disabled = 1;
+     attr.exclude_kernel = 1;
+     attr.exclude_hv = 1;
+     return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+//the cache counters encode cache, operation and result in one config
+static uint64_t cache_miss(uint64_t cache) {
+     return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+void enable_perf() {
+     perf.enabled = true;
+     perf.fds[PERF_CYCLES] = open_counter(PERF_TYPE_HARDWARE,
+                                          PERF_COUNT_HW_CPU_CYCLES);
+     perf.fds[PERF_INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE,
+                                                PERF_COUNT_HW_INSTRUCTIONS);
+     perf.fds[PERF_BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE,
+                                                 PERF_COUNT_HW_BRANCH_MISSES);
+     perf.fds[PERF_L1D_MISSES] = open_counter(PERF_TYPE_HW_CACHE,
+                                              cache_miss(PERF_COUNT_HW_CACHE_L1D));
+     perf.fds[PERF_LLC_MISSES] = open_counter(PERF_TYPE_HW_CACHE,
+                                              cache_miss(PERF_COUNT_HW_CACHE_LL));
+}
+
+void free_perf() {
+     for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+          if (perf.fds[i] >= 0) close(perf.fds[i]);
+          perf.fds[i] = -1;
+     }
+     perf.enabled = false;
+}
+
+//counts accumulate over every start/stop pair, as with many REPL lines
+void perf_start() {
+     for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+          if (perf.fds[i] >= 0) ioctl(perf.fds[i], PERF_EVENT_IOC_ENABLE, 0);
+     }
+}
+
+void perf_stop() {
+     for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+          if (perf.fds[i] >= 0) ioctl(perf.fds[i], PERF_EVENT_IOC_DISABLE, 0);
+     }
+}
+
+void write_perf(FILE* file) {
+     for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+          uint64_t count;
+          if (perf.fds[i] < 0 ||
+                    read(perf.fds[i], &count, sizeof(count)) != sizeof(count)) {
+               continue;
+          }
+          fprintf(file, "%s %llu\n", counter_names[i], (unsigned long long)count);
+     }
+}
@@ -0,0 +1,36 @@
+#ifndef klox_perf_h
+#define klox_perf_h
+
+#include <stdio.h>
+
+#include "common.h"
+
+typedef enum {
+     PERF_CYCLES,
+     PERF_INSTRUCTIONS,
+     PERF_BRANCH_MISSES,
+     PERF_L1D_MISSES,
+     PERF_LLC_MISSES,
+     PERF_COUNTER_COUNT
+} perf_counter;
+
+/*   hardware performance counters read with perf_event_open(2), counting
+     this process in user mode while interpret() runs. each counter is opened
+     on its own, so one the CPU or the kernel does not offer (or a sandbox
+     that forbids them all) only leaves that counter out of the report */
+typedef struct {
+     bool enabled;
+     int fds[PERF_COUNTER_COUNT];       //-1 for unavailable counters
+} perf_counters;
+
+extern perf_counters perf;
+
+void enable_perf(void);
+void free_perf(void);
+void perf_start(void);
+void perf_stop(void);
+
+//"name value" lines for the counters that could be read
+void write_perf(FILE* file);
+
+#endif
@@ -4,12 +4,6 @@
 #include "common.h"
 #include "scanner.h"
 
-typedef struct {
-     const char* start;
-     const char* current;
-     int line;
-} scanner;
-
 scanner scan;
 
 void init_scanner(const char* source) {
@@ -18,6 +12,15 @@ void init_scanner(const char* source) {
      scan.line = 1;
 }
 
+//lets the compiler go back and scan part of the source a second time
+scanner save_scanner() {
+     return scan;
+}
+
+void restore_scanner(scanner saved) {
+     scan = saved;
+}
+
 static bool is_alpha(char c) {
      return (c >= 'a' && c <= 'z') ||
             (c >= 'A' && c <= 'Z') ||
@@ -130,7 +133,7 @@ static token_type identifier_type() {
                if (scan.current - scan.start > 1) {
                     switch (scan.start[1]) {
                          case 'a': return check_keyword(2, 3, "lse", TOKEN_FALSE);
-                         case 'o': return check_keyword(2, 1, "or", TOKEN_FOR);
+                         case 'o': return check_keyword(2, 1, "r", TOKEN_FOR);
                          case 'u': return check_keyword(2, 2, "nc", TOKEN_FUNC);
                     }
                }
@@ -202,6 +205,8 @@ token scan_token() {
           case ')': return make_token(TOKEN_RIGHT_PAREN);
           case '{': return make_token(TOKEN_LEFT_BRACE);
           case '}': return make_token(TOKEN_RIGHT_BRACE);
+          case '[': return make_token(TOKEN_LEFT_BRACKET);
+          case ']': return make_token(TOKEN_RIGHT_BRACKET);
           case ';': return make_token(TOKEN_SEMICOLON);
           case ',': return make_token(TOKEN_COMMA);
           case '.': return make_token(TOKEN_DOT);
@@ -5,6 +5,7 @@ typedef enum {
   //single-character tokens
   TOKEN_LEFT_PAREN, TOKEN_RIGHT_PAREN,
   TOKEN_LEFT_BRACE, TOKEN_RIGHT_BRACE,
+  TOKEN_LEFT_BRACKET, TOKEN_RIGHT_BRACKET,
   TOKEN_COMMA, TOKEN_DOT, TOKEN_MINUS, TOKEN_PLUS,
   TOKEN_SEMICOLON, TOKEN_SLASH, TOKEN_STAR,
 
@@ -27,6 +28,12 @@ typedef enum {
   TOKEN_EOF
 } token_type;
 
+typedef struct {
+     const char* start;
+     const char* current;
+     int line;
+} scanner;
+
 typedef struct {
      token_type type;
      const char* start;
@@ -36,5 +43,7 @@ typedef struct {
 
 void init_scanner(const char* source);
 token scan_token();
+scanner save_scanner(void);
+void restore_scanner(scanner saved);
 
 #endif
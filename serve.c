@@ -0,0 +1,289 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "memory.h"
+#include "serve.h"
+#include "socket.h"
+#include "stack.h"
+#include "vm.h"
+
+//requests larger than this are taken for garbage and end the connection
+#define MAX_REQUEST (64 * 1024 * 1024)
+#define MAX_CONNECTIONS 64
+
+//how long the server has to be idle before it tidies up, in milliseconds
+#define IDLE_MS 1000
+
+//how long a reply waits for a client that stopped reading, in milliseconds
+#define SEND_TIMEOUT_MS 10000
+
+/*   the request a connection is part way through sending. connections are
+     read as their bytes arrive, so a client that stalls halfway through
+     holds up nobody else */
+typedef struct {
+     uint8_t prefix[4];       //the big-endian length
+     char* source;            //NULL until the whole prefix has arrived
+     uint32_t length;
+     uint32_t received;       //bytes of the prefix, then of the source
+} pending_request;
+
+//what one request printed and reported, collected in two temporary files
+static int captured_out;
+static int captured_err;
+
+static bool read_exactly(int fd, void* buffer, size_t length) {
+     char* chars = buffer;
+     while (length > 0) {
+          ssize_t bytes = read(fd, chars, length);
+          if (bytes < 0 && errno == EINTR) continue;
+          if (bytes <= 0) return false;
+          chars += bytes;
+          length -= bytes;
+     }
+     return true;
+}
+
+//the server's connections do not block, a full one is waited on a while
+static bool write_exactly(int fd, const void* buffer, size_t length) {
+     const char* chars = buffer;
+     while (length > 0) {
+          ssize_t bytes = send(fd, chars, length, MSG_NOSIGNAL);
+          if (bytes < 0 && errno == EINTR) continue;
+          if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+               struct pollfd out = { .fd = fd, .events = POLLOUT };
+               if (poll(&out, 1, SEND_TIMEOUT_MS) > 0) continue;
+               return false;
+          }
+          if (bytes <= 0) return false;
+          chars += bytes;
+          length -= bytes;
+     }
+     return true;
+}
+
+static bool read_word(int fd, uint32_t* word) {
+     if (!read_exactly(fd, word, sizeof(*word))) return false;
+     *word = ntohl(*word);
+     return true;
+}
+
+static bool write_word(int fd, uint32_t word) {
+     word = htonl(word);
+     return write_exactly(fd, &word, sizeof(word));
+}
+
+//the whole contents of a capture file, which is emptied for the next request
+static char* take_capture(int fd, uint32_t* length) {
+     off_t size = lseek(fd, 0, SEEK_END);
+     if (size < 0) size = 0;
+     char* chars = malloc(size > 0 ? size : 1);
+     ssize_t bytes = pread(fd, chars, size, 0);
+     *length = bytes > 0 ? (uint32_t)bytes : 0;
+     (void)!ftruncate(fd, 0);
+     lseek(fd, 0, SEEK_SET);
+     return chars;
+}
+
+//runs one script with stdout and stderr pointed at the capture files
+static uint32_t run_captured(const char* source) {
+     flush_output(&vm.out);
+     fflush(stdout);
+     fflush(stderr);
+     int saved_out = dup(STDOUT_FILENO);
+     int saved_err = dup(STDERR_FILENO);
+     dup2(captured_out, STDOUT_FILENO);
+     dup2(captured_err, STDERR_FILENO);
+
+     result res = interpret(source);
+
+     flush_output(&vm.out);
+     fflush(stdout);
+     fflush(stderr);
+     dup2(saved_out, STDOUT_FILENO);
+     dup2(saved_err, STDERR_FILENO);
+     close(saved_out);
+     close(saved_err);
+
+     if (res == RESULT_COMPILE_ERROR) return 65;
+     if (res == RESULT_RUNTIME_ERROR) return 70;
+     return 0;
+}
+
+//runs one request and sends back its status and what it printed
+static bool answer(int conn, const char* source) {
+     uint32_t status = run_captured(source);
+
+     uint32_t out_length;
+     uint32_t err_length;
+     char* out = take_capture(captured_out, &out_length);
+     char* err = take_capture(captured_err, &err_length);
+     bool sent = write_word(conn, status) && write_word(conn, out_length) &&
+                 write_word(conn, err_length) &&
+                 write_exactly(conn, out, out_length) &&
+                 write_exactly(conn, err, err_length);
+     free(out);
+     free(err);
+     return sent;
+}
+
+/*   reads what the connection has sent so far, without waiting for more,
+     and answers every request that is complete. false once the connection
+     is done with */
+static bool serve_connection(int conn, pending_request* req) {
+     for (;;) {
+          bool in_prefix = req->source == NULL;
+          uint32_t total = in_prefix ? sizeof(req->prefix) : req->length;
+          if (req->received < total) {
+               char* into = in_prefix ? (char*)req->prefix : req->source;
+               ssize_t bytes = read(conn, into + req->received,
+                                    total - req->received);
+               if (bytes < 0 && errno == EINTR) continue;
+               if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return true;
+               }
+               if (bytes <= 0) return false;
+               req->received += bytes;
+               continue;
+          }
+
+          req->received = 0;
+          if (in_prefix) {
+               uint32_t length;
+               memcpy(&length, req->prefix, sizeof(length));
+               req->length = ntohl(length);
+               if (req->length > MAX_REQUEST) return false;
+               req->source = malloc(req->length + 1);
+               if (req->source == NULL) return false;
+               continue;
+          }
+
+          req->source[req->length] = '\0';
+          bool sent = answer(conn, req->source);
+          free(req->source);
+          req->source = NULL;
+          if (!sent) return false;
+     }
+}
+
+/*   done when nothing has arrived for a while. there is no collector, so
+     what can be given back is memory freed since the last requests (their
+     top-level chunks, capture buffers), the output buffer itself, which
+     is allocated again by the next script that prints, and the pages a
+     deep stack touched */
+static void housekeeping() {
+     free_output(&vm.out);
+     trim_stack(0);
+     malloc_trim(0);
+}
+
+//serves until the process is killed, returns only if it cannot start
+void run_server(const char* socket_path) {
+     FILE* out_file = tmpfile();
+     FILE* err_file = tmpfile();
+     if (out_file == NULL || err_file == NULL) {
+          fprintf(stderr, "could not create capture files.\n");
+          return;
+     }
+     captured_out = fileno(out_file);
+     captured_err = fileno(err_file);
+
+     int listener = listen_on(socket_path);
+     if (listener < 0) return;
+     signal(SIGPIPE, SIG_IGN);
+
+     //the listener comes first, then every open connection
+     struct pollfd fds[MAX_CONNECTIONS + 1];
+     pending_request requests[MAX_CONNECTIONS + 1];
+     int fd_count = 1;
+     fds[0].fd = listener;
+     fds[0].events = POLLIN;
+     bool tidy = true;
+
+     for (;;) {
+          int ready = poll(fds, fd_count, tidy ? -1 : IDLE_MS);
+          if (ready < 0) {
+               if (errno == EINTR) continue;
+               break;
+          }
+          if (ready == 0) {
+               housekeeping();
+               tidy = true;
+               continue;
+          }
+
+          for (int i = fd_count - 1; i > 0; i--) {
+               if (fds[i].revents == 0) continue;
+               tidy = false;
+               if (!(fds[i].revents & POLLIN) ||
+                         !serve_connection(fds[i].fd, &requests[i])) {
+                    close(fds[i].fd);
+                    free(requests[i].source);
+                    fd_count--;
+                    fds[i] = fds[fd_count];
+                    requests[i] = requests[fd_count];
+               }
+          }
+
+          if (fds[0].revents & POLLIN) {
+               int conn = accept(listener, NULL, NULL);
+               if (conn >= 0 && fd_count == MAX_CONNECTIONS + 1) {
+                    close(conn);
+               } else if (conn >= 0) {
+                    fcntl(conn, F_SETFL, O_NONBLOCK);
+                    fds[fd_count].fd = conn;
+                    fds[fd_count].events = POLLIN;
+                    requests[fd_count].source = NULL;
+                    requests[fd_count].received = 0;
+                    fd_count++;
+               }
+          }
+     }
+     close(listener);
+}
+
+/*   sends one script, copies what it printed to stdout and its errors to
+     stderr, and returns the status a klox process running it would have */
+int run_request(const char* socket_path, const char* source) {
+     int conn = connect_to(socket_path);
+     if (conn < 0) return 74;
+
+     uint32_t length = (uint32_t)strlen(source);
+     uint32_t status, out_length, err_length;
+     if (!write_word(conn, length) || !write_exactly(conn, source, length) ||
+               !read_word(conn, &status) || !read_word(conn, &out_length) ||
+               !read_word(conn, &err_length)) {
+          fprintf(stderr, "the server closed the connection early.\n");
+          close(conn);
+          return 74;
+     }
+
+     char* out = malloc(out_length + 1);
+     char* err = malloc(err_length + 1);
+     bool received = out != NULL && err != NULL &&
+                     read_exactly(conn, out, out_length) &&
+                     read_exactly(conn, err, err_length);
+     close(conn);
+
+     if (received) {
+          fwrite(out, 1, out_length, stdout);
+          fflush(stdout);
+          fwrite(err, 1, err_length, stderr);
+     } else {
+          fprintf(stderr, "the server closed the connection early.\n");
+          status = 74;
+     }
+     free(out);
+     free(err);
+     return (int)status;
+}
@@ -0,0 +1,18 @@
+#ifndef klox_serve_h
+#define klox_serve_h
+
+#include "common.h"
+
+/*   a daemon that keeps one VM alive between scripts, so later requests
+     find the globals and interned strings earlier ones left behind. it
+     listens on a Unix socket and serves connections one request at a time.
+
+     a request is a 4-byte big-endian length followed by that many bytes of
+     source, and a connection may send any number of them. each gets back
+     three big-endian 4-byte words, the status (0, 65 or 70 like a klox
+     process would exit with), the length of what the script printed and the
+     length of its error messages, followed by those two blocks */
+void run_server(const char* socket_path);
+int run_request(const char* socket_path, const char* source);
+
+#endif
@@ -0,0 +1,650 @@
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "chunk.h"
+#include "common.h"
+#include "memory.h"
+#include "object.h"
+#include "snapshot.h"
+#include "table.h"
+#include "value.h"
+#include "vm.h"
+
+#ifdef KLOX_COMPACT_HEAP
+
+/*   an image stores objects with 8-byte pointers between them and a list of
+     where those are, which the compact heap's layout has no room for */
+bool save_snapshot(const char* path) {
+     fprintf(stderr, "heap snapshots are not supported with KLOX_COMPACT_HEAP.\n");
+     return false;
+}
+
+bool load_snapshot(const char* path) {
+     fprintf(stderr, "heap snapshots are not supported with KLOX_COMPACT_HEAP.\n");
+     return false;
+}
+
+#else
+
+#define IMAGE_MAGIC "kloximg1"
+
+//sizes of everything an image stores, an image only loads into a build
+//that agrees on all of them
+typedef struct {
+     uint16_t value_size;
+     uint16_t entry_size;
+     uint16_t string_size;
+     uint16_t array_size;
+     uint16_t function_size;
+     uint16_t native_size;
+     uint16_t opcode_count;
+     uint16_t unused;
+} image_layout;
+
+/*   the image starts with this header. every pointer in the image, the ones
+     in the header included, holds an offset from the start of the image, and
+     the relocation table lists where they all are */
+typedef struct {
+     char magic[8];
+     image_layout layout;
+     uint64_t size;
+     uint64_t relocations;    //offset of the uint64_t offsets of all pointers
+     uint64_t relocation_count;
+     uint64_t natives;        //offset of a native_record per native
+     uint64_t native_count;
+     uint64_t arrays;         //offset of a pointer to every array
+     uint64_t array_count;
+     hash_table globals;
+     hash_table strings;
+} image_header;
+
+//natives are stored without their C function, loading looks it up by name
+typedef struct {
+     obj_string* name;
+     obj_native* native;
+} native_record;
+
+static image_layout current_layout() {
+     image_layout layout = {
+          sizeof(value), sizeof(entry), sizeof(obj_string), sizeof(obj_array),
+          sizeof(obj_function), sizeof(obj_native), OP_RETURN + 1, 0
+     };
+     return layout;
+}
+
+/*------------------------------ writing -------------------------------------*/
+
+//where in the image an object was put
+typedef struct {
+     obj* object;
+     uint64_t offset;
+} placed_object;
+
+typedef struct {
+     uint8_t* bytes;
+     size_t count;
+     size_t capacity;
+     uint64_t* relocations;
+     size_t relocation_count;
+     size_t relocation_capacity;
+     placed_object* placed;        //open addressing on the object's address
+     int placed_count;
+     int placed_capacity;
+     obj** pending;                //placed but not written yet
+     int pending_count;
+     int pending_capacity;
+     obj** natives;                //the natives written
+     int native_count;
+     int native_capacity;
+     uint64_t* arrays;
+     int array_count;
+     int array_capacity;
+} image_writer;
+
+#define PUSH(array, count, capacity, type, item) \
+     do { \
+          if ((capacity) < (count) + 1) { \
+               int old_capacity = (capacity); \
+               (capacity) = GROW_CAPACITY(old_capacity); \
+               (array) = GROW_ARRAY(array, type, old_capacity, capacity); \
+          } \
+          (array)[(count)++] = (item); \
+     } while (false)
+
+//zeroed space for 'size' bytes, 8-byte aligned
+static uint64_t reserve(image_writer* w, size_t size) {
+     size_t offset = (w->count + 7) & ~(size_t)7;
+     if (w->capacity < offset + size) {
+          size_t old_capacity = w->capacity;
+          while (w->capacity < offset + size) {
+               w->capacity = GROW_CAPACITY(w->capacity);
+          }
+          w->bytes = GROW_ARRAY(w->bytes, uint8_t, old_capacity, w->capacity);
+     }
+     memset(w->bytes + w->count, 0, offset + size - w->count);
+     w->count = offset + size;
+     return offset;
+}
+
+static uint64_t append(image_writer* w, const void* data, size_t size) {
+     uint64_t offset = reserve(w, size);
+     memcpy(w->bytes + offset, data, size);
+     return offset;
+}
+
+static void patch(image_writer* w, uint64_t at, const void* data, size_t size) {
+     memcpy(w->bytes + at, data, size);
+}
+
+//stores a pointer to the image offset 'target' at 'at', 0 stays NULL
+static void put_ref(image_writer* w, uint64_t at, uint64_t target) {
+     patch(w, at, &target, sizeof(target));
+     if (target == 0) return;
+
+     if (w->relocation_capacity < w->relocation_count + 1) {
+          size_t old_capacity = w->relocation_capacity;
+          w->relocation_capacity = GROW_CAPACITY(old_capacity);
+          w->relocations = GROW_ARRAY(w->relocations, uint64_t, old_capacity,
+                                      w->relocation_capacity);
+     }
+     w->relocations[w->relocation_count++] = at;
+}
+
+static size_t object_size(obj* object) {
+     switch (object->type) {
+          case OBJ_ARRAY:    return sizeof(obj_array);
+          case OBJ_FUNCTION: return sizeof(obj_function);
+          case OBJ_NATIVE:   return sizeof(obj_native);
+          case OBJ_STRING:   return sizeof(obj_string);
+     }
+     return 0;
+}
+
+static placed_object* find_placed(placed_object* placed, int capacity,
+                                  obj* object) {
+     uint32_t index = (uint32_t)(((uintptr_t)object >> 4) * 2654435761u) %
+                      capacity;
+     while (placed[index].object != NULL && placed[index].object != object) {
+          index = (index + 1) % capacity;
+     }
+     return &placed[index];
+}
+
+//the image offset of 'object', which is queued for writing the first time
+static uint64_t object_ref(image_writer* w, obj* object) {
+     if (object == NULL) return 0;
+
+     if (w->placed_capacity == 0 ||
+               w->placed_count + 1 > w->placed_capacity * 3 / 4) {
+          int capacity = GROW_CAPACITY(w->placed_capacity);
+          placed_object* placed = ALLOCATE(placed_object, capacity);
+          memset(placed, 0, sizeof(placed_object) * capacity);
+          for (int i = 0; i < w->placed_capacity; i++) {
+               if (w->placed[i].object == NULL) continue;
+               *find_placed(placed, capacity, w->placed[i].object) = w->placed[i];
+          }
+          FREE_ARRAY(placed_object, w->placed, w->placed_capacity);
+          w->placed = placed;
+          w->placed_capacity = capacity;
+     }
+
+     placed_object* slot = find_placed(w->placed, w->placed_capacity, object);
+     if (slot->object == NULL) {
+          slot->object = object;
+          slot->offset = reserve(w, object_size(object));
+          w->placed_count++;
+          PUSH(w->pending, w->pending_count, w->pending_capacity, obj*, object);
+     }
+     return slot->offset;
+}
+
+static void put_value(image_writer* w, uint64_t at, value val) {
+     patch(w, at, &val, sizeof(val));
+     if (IS_OBJ(val)) {
+          put_ref(w, at + offsetof(value, as), object_ref(w, AS_OBJ(val)));
+     }
+}
+
+static uint64_t put_values(image_writer* w, value* values, int count) {
+     if (count == 0) return 0;
+
+     uint64_t offset = reserve(w, sizeof(value) * count);
+     for (int i = 0; i < count; i++) {
+          put_value(w, offset + sizeof(value) * i, values[i]);
+     }
+     return offset;
+}
+
+//buffers go in exactly as large as they are used, with their capacity to match
+static void put_val_array(image_writer* w, uint64_t at, val_array* array) {
+     int capacity = array->count;
+     patch(w, at + offsetof(val_array, capacity), &capacity, sizeof(int));
+     put_ref(w, at + offsetof(val_array, values),
+             put_values(w, array->values, array->count));
+}
+
+static void put_object(image_writer* w, obj* object, uint64_t at) {
+     patch(w, at, object, object_size(object));
+     put_ref(w, at + offsetof(obj, next), 0);
+
+     switch (object->type) {
+          case OBJ_ARRAY: {
+               obj_array* array = (obj_array*)object;
+               put_val_array(w, at + offsetof(obj_array, items), &array->items);
+               PUSH(w->arrays, w->array_count, w->array_capacity, uint64_t, at);
+               break;
+          }
+          case OBJ_FUNCTION: {
+               obj_function* function = (obj_function*)object;
+               chunk* ch = &function->chunk;
+               uint64_t chunk_at = at + offsetof(obj_function, chunk);
+
+               put_ref(w, at + offsetof(obj_function, name),
+                       object_ref(w, (obj*)function->name));
+               put_ref(w, at + offsetof(obj_function, jit), 0);
+               put_ref(w, at + offsetof(obj_function, aot), 0);
+               patch(w, chunk_at + offsetof(chunk, capacity), &ch->count,
+                     sizeof(int));
+               put_ref(w, chunk_at + offsetof(chunk, code),
+                       ch->count == 0 ? 0 : append(w, ch->code, ch->count));
+               put_ref(w, chunk_at + offsetof(chunk, lines),
+                       ch->count == 0 ? 0 : append(w, ch->lines,
+                                                   sizeof(int) * ch->count));
+               put_val_array(w, chunk_at + offsetof(chunk, constants),
+                             &ch->constants);
+               break;
+          }
+          case OBJ_NATIVE:
+               put_ref(w, at + offsetof(obj_native, function), 0);
+               PUSH(w->natives, w->native_count, w->native_capacity, obj*, object);
+               break;
+          case OBJ_STRING: {
+               obj_string* string = (obj_string*)object;
+               put_ref(w, at + offsetof(obj_string, chars),
+                       append(w, string->chars, string->length + 1));
+               break;
+          }
+     }
+}
+
+static void put_table(image_writer* w, uint64_t at, hash_table* table) {
+     uint64_t entries = 0;
+     if (table->capacity > 0) {
+          entries = reserve(w, sizeof(entry) * table->capacity);
+          for (int i = 0; i < table->capacity; i++) {
+               entry* ent = &table->entries[i];
+               uint64_t ent_at = entries + sizeof(entry) * i;
+               put_ref(w, ent_at + offsetof(entry, key),
+                       object_ref(w, (obj*)ent->key));
+               put_value(w, ent_at + offsetof(entry, val), ent->val);
+          }
+     }
+
+     patch(w, at + offsetof(hash_table, count), &table->count, sizeof(int));
+     patch(w, at + offsetof(hash_table, capacity), &table->capacity, sizeof(int));
+     put_ref(w, at + offsetof(hash_table, entries), entries);
+}
+
+//the name a native was registered under
+static obj_string* native_name(obj* native) {
+     for (int i = 0; i < vm.natives.capacity; i++) {
+          entry* ent = &vm.natives.entries[i];
+          if (ent->key != NULL && IS_OBJ(ent->val) && AS_OBJ(ent->val) == native) {
+               return ent->key;
+          }
+     }
+     return NULL;
+}
+
+static void free_writer(image_writer* w) {
+     FREE_ARRAY(uint8_t, w->bytes, w->capacity);
+     FREE_ARRAY(uint64_t, w->relocations, w->relocation_capacity);
+     FREE_ARRAY(placed_object, w->placed, w->placed_capacity);
+     FREE_ARRAY(obj*, w->pending, w->pending_capacity);
+     FREE_ARRAY(obj*, w->natives, w->native_capacity);
+     FREE_ARRAY(uint64_t, w->arrays, w->array_capacity);
+}
+
+bool save_snapshot(const char* path) {
+     image_writer writer;
+     memset(&writer, 0, sizeof(writer));
+     image_writer* w = &writer;
+
+     uint64_t header = reserve(w, sizeof(image_header));
+     put_table(w, header + offsetof(image_header, globals), &vm.globals);
+     put_table(w, header + offsetof(image_header, strings), &vm.strings);
+     while (w->pending_count > 0) {
+          obj* object = w->pending[--w->pending_count];
+          put_object(w, object, object_ref(w, object));
+     }
+
+     //native names are interned, so writing them queues nothing new
+     uint64_t natives = reserve(w, sizeof(native_record) * w->native_count);
+     for (int i = 0; i < w->native_count; i++) {
+          uint64_t at = natives + sizeof(native_record) * i;
+          obj_string* name = native_name(w->natives[i]);
+          if (name == NULL) {
+               fprintf(stderr, "could not find the name of a native function.\n");
+               free_writer(w);
+               return false;
+          }
+          put_ref(w, at + offsetof(native_record, name), object_ref(w, (obj*)name));
+          put_ref(w, at + offsetof(native_record, native),
+                  object_ref(w, w->natives[i]));
+     }
+
+     uint64_t arrays = reserve(w, sizeof(uint64_t) * w->array_count);
+     for (int i = 0; i < w->array_count; i++) {
+          put_ref(w, arrays + sizeof(uint64_t) * i, w->arrays[i]);
+     }
+
+     //the relocation table is last, nothing after it adds pointers
+     size_t relocation_count = w->relocation_count;
+     uint64_t relocations = append(w, w->relocations,
+                                   sizeof(uint64_t) * relocation_count);
+
+     image_header* h = (image_header*)(w->bytes + header);
+     memcpy(h->magic, IMAGE_MAGIC, sizeof(h->magic));
+     h->layout = current_layout();
+     h->size = w->count;
+     h->relocations = relocations;
+     h->relocation_count = relocation_count;
+     h->natives = natives;
+     h->native_count = w->native_count;
+     h->arrays = arrays;
+     h->array_count = w->array_count;
+
+     FILE* file = fopen(path, "wb");
+     bool ok = file != NULL && fwrite(w->bytes, 1, w->count, file) == w->count;
+     if (file != NULL && fclose(file) != 0) ok = false;
+     if (!ok) fprintf(stderr, "could not write image \"%s\".\n", path);
+
+     free_writer(w);
+     return ok;
+}
+
+/*------------------------------ loading -------------------------------------*/
+
+//the image's tables are copied out, growing them must not free image memory
+static hash_table copy_table(hash_table* from) {
+     hash_table table = *from;
+     table.entries = ALLOCATE(entry, from->capacity);
+     if (from->capacity > 0) {
+          memcpy(table.entries, from->entries, sizeof(entry) * from->capacity);
+     }
+     return table;
+}
+
+static obj_native* current_native(obj_string* name) {
+     for (int i = 0; i < vm.natives.capacity; i++) {
+          entry* ent = &vm.natives.entries[i];
+          if (ent->key != NULL && ent->key->length == name->length &&
+                    memcmp(ent->key->chars, name->chars, name->length) == 0) {
+               return AS_NATIVE(ent->val);
+          }
+     }
+     return NULL;
+}
+
+//whether 'count' records of 'size' bytes at 'offset' fit in 'length' bytes
+static bool within(uint64_t offset, uint64_t count, size_t size,
+                   uint64_t length) {
+     return offset % 8 == 0 && offset <= length &&
+            count <= (length - offset) / size;
+}
+
+/*   walks every object reachable from the header of a relocated image and
+     checks that all of it lies within the image: the object itself for its
+     type, and the buffers it points to for as far as it says they extend */
+typedef struct {
+     uint8_t* base;
+     uint64_t size;
+     uint8_t* seen;           //a bit per 8 bytes, set at each object checked
+     obj** pending;           //checked themselves, their contents not yet
+     int pending_count;
+     int pending_capacity;
+} image_checker;
+
+//whether 'count' records of 'size' bytes at 'pointer' lie within the image
+static bool inside(image_checker* c, const void* pointer, uint64_t count,
+                   size_t size, size_t align) {
+     uintptr_t at = (uintptr_t)pointer;
+     if (at < (uintptr_t)c->base || at % align != 0) return false;
+     uint64_t offset = at - (uintptr_t)c->base;
+     return offset <= c->size && count <= (c->size - offset) / size;
+}
+
+//an empty buffer is never read, so its pointer may be anything
+static bool check_buffer(image_checker* c, const void* pointer, int count,
+                         size_t size, size_t align) {
+     return count == 0 || inside(c, pointer, (uint64_t)count, size, align);
+}
+
+//'type' is -1 for an object of any type
+static bool check_object(image_checker* c, obj* object, int type) {
+     if (!inside(c, object, 1, sizeof(obj), 8)) return false;
+     if ((unsigned)object->type > OBJ_STRING) return false;
+     if (type != -1 && object->type != (obj_type)type) return false;
+     if (!inside(c, object, 1, object_size(object), 8)) return false;
+
+     uint64_t index = ((uint8_t*)object - c->base) / 8;
+     if (c->seen[index / 8] & (1 << (index % 8))) return true;
+     c->seen[index / 8] |= (uint8_t)(1 << (index % 8));
+     PUSH(c->pending, c->pending_count, c->pending_capacity, obj*, object);
+     return true;
+}
+
+static bool check_value(image_checker* c, value* val) {
+     if ((unsigned)val->type > VAL_OBJ) return false;
+     return val->type != VAL_OBJ || check_object(c, val->as.object, -1);
+}
+
+static bool check_val_array(image_checker* c, val_array* array) {
+     if (array->count < 0 || array->capacity < array->count ||
+               !check_buffer(c, array->values, array->capacity, sizeof(value),
+                             _Alignof(value))) {
+          return false;
+     }
+     for (int i = 0; i < array->count; i++) {
+          if (!check_value(c, &array->values[i])) return false;
+     }
+     return true;
+}
+
+static bool check_table(image_checker* c, hash_table* table) {
+     if (table->count < 0 || table->capacity < table->count ||
+               !check_buffer(c, table->entries, table->capacity, sizeof(entry),
+                             _Alignof(entry))) {
+          return false;
+     }
+     for (int i = 0; i < table->capacity; i++) {
+          entry* ent = &table->entries[i];
+          if (ent->key != NULL && !check_object(c, (obj*)ent->key, OBJ_STRING)) {
+               return false;
+          }
+          if (!check_value(c, &ent->val)) return false;
+     }
+     return true;
+}
+
+//what an object points to, once the object itself is known to be in the image
+static bool check_contents(image_checker* c, obj* object) {
+     switch (object->type) {
+          case OBJ_ARRAY:
+               return check_val_array(c, &((obj_array*)object)->items);
+          case OBJ_FUNCTION: {
+               obj_function* function = (obj_function*)object;
+               chunk* ch = &function->chunk;
+               if (function->name != NULL &&
+                         !check_object(c, (obj*)function->name, OBJ_STRING)) {
+                    return false;
+               }
+               return function->jit == NULL && function->aot == NULL &&
+                      ch->arenas == NULL && ch->count >= 0 &&
+                      ch->capacity >= ch->count &&
+                      check_buffer(c, ch->code, ch->capacity, 1, 1) &&
+                      check_buffer(c, ch->lines, ch->capacity, sizeof(int),
+                                   _Alignof(int)) &&
+                      check_val_array(c, &ch->constants);
+          }
+          case OBJ_NATIVE:
+               return true;
+          case OBJ_STRING: {
+               obj_string* string = (obj_string*)object;
+               return string->length >= 0 &&
+                      inside(c, string->chars, (uint64_t)string->length + 1,
+                             1, 1) &&
+                      string->chars[string->length] == '\0';
+          }
+     }
+     return false;
+}
+
+static bool check_image(uint8_t* base, image_header* header) {
+     image_checker checker = { base, header->size, NULL, NULL, 0, 0 };
+     image_checker* c = &checker;
+     size_t seen_size = header->size / 64 + 1;
+     c->seen = ALLOCATE(uint8_t, seen_size);
+     memset(c->seen, 0, seen_size);
+
+     bool ok = check_table(c, &header->globals) &&
+               check_table(c, &header->strings);
+
+     native_record* natives = (native_record*)(base + header->natives);
+     for (uint64_t i = 0; ok && i < header->native_count; i++) {
+          ok = check_object(c, (obj*)natives[i].name, OBJ_STRING) &&
+               check_object(c, (obj*)natives[i].native, OBJ_NATIVE);
+     }
+     obj_array** arrays = (obj_array**)(base + header->arrays);
+     for (uint64_t i = 0; ok && i < header->array_count; i++) {
+          ok = check_object(c, (obj*)arrays[i], OBJ_ARRAY);
+     }
+
+     while (ok && c->pending_count > 0) {
+          ok = check_contents(c, c->pending[--c->pending_count]);
+     }
+
+     FREE_ARRAY(uint8_t, c->seen, seen_size);
+     FREE_ARRAY(obj*, c->pending, c->pending_capacity);
+     return ok;
+}
+
+/*   turns the offsets in a mapped image into pointers. every table the
+     header points to and every pointer has to lie within the image, and so
+     does every object reachable from the header, with all it points to, or
+     the image is rejected before anything else reads it */
+static bool relocate(uint8_t* base, image_header* header) {
+     uint64_t size = header->size;
+     if (!within(header->relocations, header->relocation_count,
+                 sizeof(uint64_t), size) ||
+               !within(header->natives, header->native_count,
+                       sizeof(native_record), size) ||
+               !within(header->arrays, header->array_count,
+                       sizeof(obj_array*), size)) {
+          return false;
+     }
+
+     uint64_t* relocations = (uint64_t*)(base + header->relocations);
+     for (uint64_t i = 0; i < header->relocation_count; i++) {
+          if (!within(relocations[i], 1, sizeof(uintptr_t), size)) return false;
+          uintptr_t* pointer = (uintptr_t*)(base + relocations[i]);
+          if (*pointer == 0 || *pointer >= size) return false;
+          *pointer += (uintptr_t)base;
+     }
+
+     return check_image(base, header);
+}
+
+/*   the image stays mapped for the rest of the process. its objects are not
+     on vm.objects, so nothing ever frees them, and the only buffers that can
+     grow (tables and arrays) are copied to the heap */
+bool load_snapshot(const char* path) {
+     int fd = open(path, O_RDONLY);
+     struct stat st;
+     if (fd < 0 || fstat(fd, &st) != 0) {
+          if (fd >= 0) close(fd);
+          fprintf(stderr, "could not open image \"%s\".\n", path);
+          return false;
+     }
+
+     uint8_t* base = NULL;
+     if ((size_t)st.st_size >= sizeof(image_header)) {
+          base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                      fd, 0);
+          if (base == MAP_FAILED) base = NULL;
+     }
+     close(fd);
+
+     image_header* header = (image_header*)base;
+     image_layout layout = current_layout();
+     if (base == NULL || memcmp(header->magic, IMAGE_MAGIC, 8) != 0 ||
+               memcmp(&header->layout, &layout, sizeof(layout)) != 0 ||
+               header->size != (uint64_t)st.st_size) {
+          if (base != NULL) munmap(base, st.st_size);
+          fprintf(stderr, "\"%s\" is not an image of this klox build.\n", path);
+          return false;
+     }
+
+     if (!relocate(base, header)) {
+          munmap(base, st.st_size);
+          fprintf(stderr, "image \"%s\" is damaged.\n", path);
+          return false;
+     }
+
+     native_record* natives = (native_record*)(base + header->natives);
+     for (uint64_t i = 0; i < header->native_count; i++) {
+          obj_native* native = current_native(natives[i].name);
+          if (native == NULL) {
+               fprintf(stderr, "image \"%s\" needs the native function '%s'.\n",
+                       path, natives[i].name->chars);
+               munmap(base, st.st_size);
+               return false;
+          }
+          natives[i].native->function = native->function;
+          natives[i].native->arity = native->arity;
+     }
+
+     obj_array** arrays = (obj_array**)(base + header->arrays);
+     for (uint64_t i = 0; i < header->array_count; i++) {
+          val_array* items = &arrays[i]->items;
+          value* values = ALLOCATE(value, items->capacity);
+          if (items->count > 0) {
+               memcpy(values, items->values, sizeof(value) * items->count);
+          }
+          items->values = values;
+     }
+
+     hash_table old_natives = vm.natives;
+     free_table(&vm.globals);
+     free_table(&vm.strings);
+     vm.globals = copy_table(&header->globals);
+     vm.strings = copy_table(&header->strings);
+     init_table(&vm.natives);
+     for (uint64_t i = 0; i < header->native_count; i++) {
+          table_set(&vm.natives, natives[i].name, OBJ_VAL(natives[i].native));
+     }
+
+     //natives the image does not hold, because the prelude shadowed them or
+     //they are new, keep their own objects under the image's strings
+     for (int i = 0; i < old_natives.capacity; i++) {
+          entry* ent = &old_natives.entries[i];
+          if (ent->key == NULL) continue;
+
+          obj_string* name = copy_string(ent->key->chars, ent->key->length);
+          value existing;
+          if (table_get(&vm.natives, name, &existing)) continue;
+          table_set(&vm.natives, name, ent->val);
+          if (!table_get(&vm.globals, name, &existing)) {
+               table_set(&vm.globals, name, ent->val);
+          }
+     }
+     free_table(&old_natives);
+     return true;
+}
+
+#endif
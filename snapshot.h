@@ -0,0 +1,14 @@
+#ifndef klox_snapshot_h
+#define klox_snapshot_h
+
+#include "common.h"
+
+/*   heap images. save_snapshot writes vm.globals, vm.strings and every
+     object they reach into one file, with pointers stored as offsets into
+     it. load_snapshot maps such a file after init_vm, adds the address it
+     was mapped at to every pointer and makes its tables the VM's. images
+     only fit the klox build that wrote them */
+bool save_snapshot(const char* path);
+bool load_snapshot(const char* path);
+
+#endif
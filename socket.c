@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "socket.h"
+
+static bool fill_address(struct sockaddr_un* address, const char* path) {
+     memset(address, 0, sizeof(*address));
+     address->sun_family = AF_UNIX;
+     if (strlen(path) >= sizeof(address->sun_path)) {
+          fprintf(stderr, "socket path \"%s\" is too long.\n", path);
+          return false;
+     }
+     strcpy(address->sun_path, path);
+     return true;
+}
+
+//replaces whatever is at 'path' with a listening socket
+int listen_on(const char* path) {
+     struct sockaddr_un address;
+     if (!fill_address(&address, path)) return -1;
+
+     int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+     unlink(path);
+     if (listener < 0 ||
+               bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+               listen(listener, SOMAXCONN) != 0) {
+          if (listener >= 0) close(listener);
+          fprintf(stderr, "could not listen on \"%s\".\n", path);
+          return -1;
+     }
+     return listener;
+}
+
+int connect_to(const char* path) {
+     struct sockaddr_un address;
+     if (!fill_address(&address, path)) return -1;
+
+     int conn = socket(AF_UNIX, SOCK_STREAM, 0);
+     if (conn < 0 || connect(conn, (struct sockaddr*)&address,
+                             sizeof(address)) != 0) {
+          if (conn >= 0) close(conn);
+          fprintf(stderr, "could not connect to \"%s\".\n", path);
+          return -1;
+     }
+     return conn;
+}
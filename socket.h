@@ -0,0 +1,11 @@
+#ifndef klox_socket_h
+#define klox_socket_h
+
+#include "common.h"
+
+/*   the Unix socket plumbing the fork server and the daemon share. both
+     report what went wrong on stderr and return -1 */
+int listen_on(const char* path);
+int connect_to(const char* path);
+
+#endif
@@ -0,0 +1,99 @@
+#include <signal.h>
+#include <sys/mman.h>
+
+#include "stack.h"
+
+//one page is enough, pushes move the top a slot at a time
+#define STACK_GUARD 4096
+
+sigjmp_buf overflow_jump;
+volatile bool stack_guarded = false;
+
+static uint8_t* region = NULL;     //the frames, then the values
+static size_t region_size = 0;     //all of it, the guard page included
+static size_t frame_bytes = 0;
+static uint8_t* base = NULL;       //the first value slot
+static size_t usable = 0;
+static struct sigaction previous;
+static bool installed = false;
+
+static void on_fault(int sig, siginfo_t* info, void* context) {
+     (void)sig;
+     (void)context;
+     uint8_t* address = info->si_addr;
+     uint8_t* guard = base + usable;
+     if (stack_guarded && base != NULL && address >= guard &&
+               address < guard + STACK_GUARD) {
+          stack_guarded = false;
+          siglongjmp(overflow_jump, 1);
+     }
+
+     /*   not ours, so it goes to the old handler. a fault would come back
+          when the instruction runs again, but a SIGSEGV sent with kill()
+          would not, so it is raised again either way */
+     sigaction(SIGSEGV, &previous, NULL);
+     installed = false;
+     raise(SIGSEGV);
+}
+
+/*   SA_NODEFER leaves SIGSEGV unblocked after the jump out of the handler,
+     so executions need not save the signal mask each time they start */
+static void install_handler() {
+     struct sigaction action;
+     action.sa_sigaction = on_fault;
+     action.sa_flags = SA_SIGINFO | SA_NODEFER;
+     sigemptyset(&action.sa_mask);
+     if (sigaction(SIGSEGV, &action, &previous) == 0) installed = true;
+}
+
+static size_t round_to_pages(size_t size) {
+     return (size + 4095) & ~(size_t)4095;
+}
+
+bool reserve_stack(size_t size, size_t frame_size, value** values,
+                   void** frames) {
+     size = round_to_pages(size);
+     if (size == 0) return false;
+     size_t slots = size / sizeof(value);
+     size_t frames_size = round_to_pages(slots * frame_size);
+     size_t total = frames_size + size + STACK_GUARD;
+
+     uint8_t* start = mmap(NULL, total, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+     if (start == MAP_FAILED) return false;
+     if (mprotect(start + frames_size + size, STACK_GUARD, PROT_NONE) != 0) {
+          munmap(start, total);
+          return false;
+     }
+
+     release_stack();
+     region = start;
+     region_size = total;
+     frame_bytes = frame_size;
+     base = start + frames_size;
+     usable = size;
+     if (!installed) install_handler();
+
+     *values = (value*)base;
+     *frames = region;
+     return true;
+}
+
+void release_stack() {
+     if (region != NULL) munmap(region, region_size);
+     region = NULL;
+     region_size = 0;
+     base = NULL;
+     usable = 0;
+}
+
+static void trim(uint8_t* start, size_t length, size_t keep) {
+     keep = round_to_pages(keep);
+     if (length > keep) madvise(start + keep, length - keep, MADV_DONTNEED);
+}
+
+void trim_stack(size_t keep) {
+     if (region == NULL) return;
+     trim(base, usable, keep);
+     trim(region, base - region, keep / sizeof(value) * frame_bytes);
+}
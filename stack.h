@@ -0,0 +1,37 @@
+#ifndef klox_stack_h
+#define klox_stack_h
+
+#include <setjmp.h>
+
+#include "common.h"
+#include "value.h"
+
+/*   the VM's value stack is a reservation of address space followed by a
+     guard page. the kernel only backs the pages the stack reaches, so it
+     grows as deep as a script needs without being copied, and pushes never
+     check for room: one that runs into the guard page faults, and the
+     SIGSEGV handler installed by reserve_stack() jumps to the target of
+     the running execution, which reports a stack overflow. the call frames
+     sit in the same reservation, one for every value slot: each frame has
+     its callee in a slot of its own, so they run out after the values do
+     and calls need no check either */
+#define STACK_SIZE_DEFAULT (16 * 1024 * 1024)
+
+/*   reserves 'size' bytes of value slots, rounded up to whole pages, behind
+     room for one frame of 'frame_size' bytes per slot. the earlier
+     reservation is only unmapped once the new one is in place, so on
+     failure it is left as it was and false is returned */
+bool reserve_stack(size_t size, size_t frame_size, value** values,
+                   void** frames);
+void release_stack(void);
+
+//gives back the pages of the values above 'keep' bytes and their frames
+void trim_stack(size_t keep);
+
+/*   where a push into the guard page continues. an execution sets it with
+     sigsetjmp(overflow_jump, 0) and keeps 'stack_guarded' true while it
+     runs; faults at any other time are passed on to the previous handler */
+extern sigjmp_buf overflow_jump;
+extern volatile bool stack_guarded;
+
+#endif
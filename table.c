@@ -8,6 +8,18 @@
 
 #define TABLE_MAX_LOAD 0.75
 
+#ifdef KLOX_COMPACT_HEAP
+#define NO_KEY 0
+#define KEY_OF(string) obj_to_ref((obj*)(string))
+#define STRING_OF(key) ((obj_string*)ref_to_obj(key))
+#define ENTRY_HASH(ent) ((ent)->hash)
+#else
+#define NO_KEY NULL
+#define KEY_OF(string) (string)
+#define STRING_OF(key) (key)
+#define ENTRY_HASH(ent) ((ent)->key->hash)
+#endif
+
 void init_table(hash_table* table) {
      table->count = 0;
      table->capacity = 0;
@@ -19,13 +31,14 @@ void free_table(hash_table* table) {
      init_table(table);
 }
 
-static entry* find_entry(entry* entries, int capacity, obj_string* key) {
-     uint32_t index = key->hash % capacity;
+static entry* find_entry(entry* entries, int capacity, table_key key,
+                         uint32_t hash) {
+     uint32_t index = hash % capacity;
      entry* tombstone = NULL;
      for (;;) {
           entry* ent = &entries[index];
 
-          if (ent->key == NULL) {
+          if (ent->key == NO_KEY) {
                if (IS_NULL(ent->val)) {
                     //empty entry
                     return tombstone != NULL ? tombstone : ent;
@@ -45,8 +58,9 @@ static entry* find_entry(entry* entries, int capacity, obj_string* key) {
 bool table_get(hash_table* table, obj_string* key, value* val) {
      if (table->count == 0) return false;
 
-     entry* ent = find_entry(table->entries, table->capacity, key);
-     if (ent->key == NULL) return false;
+     entry* ent = find_entry(table->entries, table->capacity, KEY_OF(key),
+                             key->hash);
+     if (ent->key == NO_KEY) return false;
 
      *val = ent->val;
      return true;
@@ -56,18 +70,17 @@ static void adjust_capacity(hash_table* table, int capacity) {
      entry* entries = ALLOCATE(entry, capacity);
 
      for (int i = 0; i < capacity; i++) {
-          entries[i].key = NULL;
+          entries[i].key = NO_KEY;
           entries[i].val = NULL_VAL;
      }
 
      table->count = 0;
      for (int i = 0; i < table->capacity; i++) {
           entry* ent = &table->entries[i];
-          if (ent->key == NULL) continue;
+          if (ent->key == NO_KEY) continue;
 
-          entry* dest = find_entry(entries, capacity, ent->key);
-          dest->key = ent->key;
-          dest->val = ent->val;
+          entry* dest = find_entry(entries, capacity, ent->key, ENTRY_HASH(ent));
+          *dest = *ent;
           table->count++;
      }
 
@@ -83,12 +96,16 @@ bool table_set(hash_table* table, obj_string* key, value val) {
           adjust_capacity(table, capacity);
      }
 
-     entry* ent = find_entry(table->entries, table->capacity, key);
+     entry* ent = find_entry(table->entries, table->capacity, KEY_OF(key),
+                             key->hash);
 
-     bool is_new = (ent->key == NULL);
+     bool is_new = (ent->key == NO_KEY);
      if (is_new && IS_NULL(ent->val)) table->count++;
 
-     ent->key = key;
+     ent->key = KEY_OF(key);
+#ifdef KLOX_COMPACT_HEAP
+     ent->hash = key->hash;
+#endif
      ent->val = val;
      return is_new;
 }
@@ -96,10 +113,11 @@ bool table_set(hash_table* table, obj_string* key, value val) {
 bool table_delete(hash_table* table, obj_string* key) {
      if (table->count == 0) return false;
 
-     entry* ent = find_entry(table->entries, table->capacity, key);
-     if (ent->key == NULL) return false;
+     entry* ent = find_entry(table->entries, table->capacity, KEY_OF(key),
+                             key->hash);
+     if (ent->key == NO_KEY) return false;
 
-     ent->key = NULL;
+     ent->key = NO_KEY;
      ent->val = BOOL_VAL(true);
 
      return true;
@@ -108,8 +126,8 @@ bool table_delete(hash_table* table, obj_string* key) {
 void table_add_all(hash_table* from, hash_table* to) {
      for (int i = 0; i < from->capacity; i++) {
           entry* ent = &from->entries[i];
-          if (ent->key != NULL) {
-               table_set(to, ent->key, ent->val);
+          if (ent->key != NO_KEY) {
+               table_set(to, STRING_OF(ent->key), ent->val);
           }
      }
 }
@@ -123,14 +141,16 @@ obj_string* table_find_string(hash_table* table, const char* chars, int length,
      for (;;) {
           entry* ent = &table->entries[index];
 
-          if (ent->key == NULL) {
+          if (ent->key == NO_KEY) {
                // Stop if we find an empty non-tombstone entry.
                if (IS_NULL(ent->val)) return NULL;
-          } else if (ent->key->length == length &&
-                     ent->key->hash == hash &&
-                     memcmp(ent->key->chars, chars, length) == 0) {
-               // We found it.
-               return ent->key;
+          } else if (ENTRY_HASH(ent) == hash) {
+               obj_string* key = STRING_OF(ent->key);
+               if (key->length == length &&
+                   memcmp(key->chars, chars, length) == 0) {
+                    // We found it.
+                    return key;
+               }
           }
 
           index = (index + 1) % table->capacity;
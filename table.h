@@ -4,17 +4,37 @@
 #include "common.h"
 #include "value.h"
 
+#ifdef KLOX_COMPACT_HEAP
+
+/*   a key is a 32-bit reference into the object heap, which leaves room for
+     its hash in the same 8 bytes, so a probe only follows the key that
+     matches */
+typedef uint32_t table_key;
+
+typedef struct {
+     table_key key;
+     uint32_t hash;
+     value val;
+} entry;
+
+#else
+
+typedef obj_string* table_key;
+
 typedef struct {
-     obj_string* key;
+     table_key key;
      value val;
 } entry;
 
+#endif
+
 typedef struct {
      int count;
      int capacity;
      entry* entries;
 } hash_table;
 
+//keys are compared by pointer, so they have to be interned strings
 void init_table(hash_table* table);
 void free_table(hash_table* table);
 bool table_get(hash_table* table, obj_string* key, value* val);
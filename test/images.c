@@ -0,0 +1,160 @@
+/*   checks that load_snapshot rejects damaged images instead of reading
+     outside them. an image of a small prelude is saved, then each case
+     damages one field of a copy of it and expects the copy to be refused.
+     snapshot.c is included rather than linked, for its image layout */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "snapshot.c"
+
+static const char* prelude =
+     "let greeting = \"hello\";\n"
+     "let items = [1, 2.5, \"three\", [4]];\n"
+     "func add(a, b) { return a + b; }\n";
+
+static uint8_t* image;
+static size_t image_size;
+static const char* path;
+static int failures = 0;
+
+static void* at(uint8_t* bytes, uint64_t offset) {
+     return bytes + offset;
+}
+
+static uint8_t* read_image() {
+     FILE* file = fopen(path, "rb");
+     if (file == NULL) return NULL;
+     fseek(file, 0, SEEK_END);
+     image_size = (size_t)ftell(file);
+     rewind(file);
+     uint8_t* bytes = malloc(image_size);
+     if (fread(bytes, 1, image_size, file) != image_size) {
+          free(bytes);
+          bytes = NULL;
+     }
+     fclose(file);
+     return bytes;
+}
+
+static void write_image(uint8_t* bytes) {
+     FILE* file = fopen(path, "wb");
+     if (file == NULL || fwrite(bytes, 1, image_size, file) != image_size) {
+          fprintf(stderr, "could not write \"%s\".\n", path);
+          exit(1);
+     }
+     fclose(file);
+}
+
+//the object a global of the given type points to, as an offset
+static uint64_t find_global(uint8_t* bytes, obj_type type) {
+     image_header* header = (image_header*)bytes;
+     entry* entries = at(bytes, (uintptr_t)header->globals.entries);
+     for (int i = 0; i < header->globals.capacity; i++) {
+          value* val = &entries[i].val;
+          if (entries[i].key == NULL || val->type != VAL_OBJ) continue;
+          uint64_t offset = (uintptr_t)val->as.object;
+          if (((obj*)at(bytes, offset))->type == type) return offset;
+     }
+     fprintf(stderr, "the prelude has no global of type %d.\n", type);
+     exit(1);
+}
+
+static void expect(const char* name, uint8_t* bytes, bool loads) {
+     write_image(bytes);
+     bool loaded = load_snapshot(path);
+     printf("%-40s %s\n", name, loaded == loads ? "ok" : "FAILED");
+     if (loaded != loads) failures++;
+}
+
+typedef void (*damage_fn)(uint8_t* bytes);
+
+static void damaged(const char* name, damage_fn damage) {
+     uint8_t* bytes = malloc(image_size);
+     memcpy(bytes, image, image_size);
+     damage(bytes);
+     expect(name, bytes, false);
+     free(bytes);
+}
+
+static void table_capacity(uint8_t* bytes) {
+     ((image_header*)bytes)->globals.capacity = 1 << 24;
+}
+
+static void entries_at_end(uint8_t* bytes) {
+     ((image_header*)bytes)->globals.entries = (entry*)(image_size - 8);
+}
+
+static void string_length(uint8_t* bytes) {
+     obj_string* string = at(bytes, find_global(bytes, OBJ_STRING));
+     string->length = (int)image_size;
+}
+
+static void string_chars_at_end(uint8_t* bytes) {
+     obj_string* string = at(bytes, find_global(bytes, OBJ_STRING));
+     string->chars = (char*)(image_size - 1);
+}
+
+static void array_count(uint8_t* bytes) {
+     obj_array* array = at(bytes, find_global(bytes, OBJ_ARRAY));
+     array->items.count = array->items.capacity + 1;
+}
+
+static void array_capacity(uint8_t* bytes) {
+     obj_array* array = at(bytes, find_global(bytes, OBJ_ARRAY));
+     array->items.capacity = 1 << 28;
+}
+
+static void chunk_size(uint8_t* bytes) {
+     obj_function* function = at(bytes, find_global(bytes, OBJ_FUNCTION));
+     function->chunk.count = function->chunk.capacity = 1 << 28;
+}
+
+//every global's object is moved to the last aligned bytes of the image
+static void object_at_end(uint8_t* bytes) {
+     image_header* header = (image_header*)bytes;
+     entry* entries = at(bytes, (uintptr_t)header->globals.entries);
+     for (int i = 0; i < header->globals.capacity; i++) {
+          if (entries[i].val.type == VAL_OBJ) {
+               entries[i].val.as.object = (obj*)((image_size - 8) & ~(size_t)7);
+          }
+     }
+}
+
+static void value_type(uint8_t* bytes) {
+     image_header* header = (image_header*)bytes;
+     entry* entries = at(bytes, (uintptr_t)header->globals.entries);
+     for (int i = 0; i < header->globals.capacity; i++) {
+          if (entries[i].key != NULL) entries[i].val.type = (val_type)99;
+     }
+}
+
+int main(int argc, const char* argv[]) {
+     path = argc > 1 ? argv[1] : "images-test.img";
+
+     init_vm();
+     if (interpret(prelude) != RESULT_OK || !save_snapshot(path) ||
+               (image = read_image()) == NULL) {
+          fprintf(stderr, "could not make the test image.\n");
+          return 1;
+     }
+
+     damaged("table capacity past the end", table_capacity);
+     damaged("table entries at the last bytes", entries_at_end);
+     damaged("string length past the end", string_length);
+     damaged("string chars at the last byte", string_chars_at_end);
+     damaged("array count over its capacity", array_count);
+     damaged("array capacity past the end", array_capacity);
+     damaged("chunk past the end", chunk_size);
+     damaged("object at the last bytes", object_at_end);
+     damaged("value of no type", value_type);
+
+     //the intact image goes last, loading it replaces the VM's tables
+     expect("intact image", image, true);
+
+     free(image);
+     remove(path);
+     free_vm();
+     return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "number.h"
+#include "object.h"
+#include "trace.h"
+
+tracer trace;
+
+void enable_trace(int dump_count) {
+     trace.count = 0;
+     trace.enabled = true;
+     trace.dump_count = dump_count > TRACE_SIZE ? TRACE_SIZE : dump_count;
+}
+
+/*   dumps are put together by hand rather than with snprintf, which is not
+     safe to call from a signal handler. a line that does not fit is cut */
+typedef struct {
+     char chars[160];
+     int length;
+} trace_line;
+
+static void put_chars(trace_line* line, const char* chars, int length) {
+     int room = (int)sizeof(line->chars) - 1 - line->length;
+     if (length > room) length = room;
+     memcpy(line->chars + line->length, chars, length);
+     line->length += length;
+}
+
+static void put_string(trace_line* line, const char* string) {
+     put_chars(line, string, (int)strlen(string));
+}
+
+//'width' pads with zeros on the left
+static void put_unsigned(trace_line* line, uint64_t number, int width) {
+     char digits[20];
+     int count = 0;
+     do {
+          digits[sizeof(digits) - 1 - count++] = (char)('0' + number % 10);
+          number /= 10;
+     } while (number > 0);
+     while (count < width && count < (int)sizeof(digits)) {
+          digits[sizeof(digits) - 1 - count++] = '0';
+     }
+     put_chars(line, digits + sizeof(digits) - count, count);
+}
+
+static void put_signed(trace_line* line, int64_t number) {
+     if (number < 0) put_chars(line, "-", 1);
+     put_unsigned(line, number < 0 ? -(uint64_t)number : (uint64_t)number, 0);
+}
+
+static void put_hex(trace_line* line, uint64_t number) {
+     char digits[18] = "0x";
+     int count = 2;
+     int shift = 60;
+     while (shift > 0 && ((number >> shift) & 0xf) == 0) shift -= 4;
+     for (; shift >= 0; shift -= 4) {
+          digits[count++] = "0123456789abcdef"[(number >> shift) & 0xf];
+     }
+     put_chars(line, digits, count);
+}
+
+//'string' padded with spaces to 'width' characters
+static void put_padded(trace_line* line, const char* string, int width) {
+     put_string(line, string);
+     for (int i = (int)strlen(string); i < width; i++) put_chars(line, " ", 1);
+}
+
+static void put_function(trace_line* line, obj_function* function,
+                         bool objects) {
+     if (!objects) {
+          put_string(line, "<fn ");
+          put_hex(line, (uintptr_t)function);
+          put_string(line, ">");
+     } else if (function->name == NULL) {
+          put_string(line, "script");
+     } else {
+          put_string(line, function->name->chars);
+     }
+}
+
+/*   the recorded top of stack, without touching the live stack. doubles
+     from a crash handler are shown as their bits, format_number can fall
+     back on snprintf */
+static void put_top(trace_line* line, trace_record* rec, bool objects) {
+     value val;
+     val.type = (val_type)rec->top_type;
+     memcpy(&val.as, &rec->top_bits, sizeof(rec->top_bits));
+
+     switch (val.type) {
+          case VAL_BOOL:   put_string(line, AS_BOOL(val) ? "true" : "false"); return;
+          case VAL_NULL:   put_string(line, "null"); return;
+          case VAL_INT:    put_signed(line, AS_INT(val)); return;
+          case VAL_NUMBER:
+               if (objects) {
+                    char number[NUMBER_BUFFER_SIZE];
+                    put_chars(line, number, format_number(AS_NUMBER(val), number));
+               } else {
+                    put_string(line, "<double ");
+                    put_hex(line, rec->top_bits);
+                    put_string(line, ">");
+               }
+               return;
+          case VAL_OBJ:
+               if (objects && IS_STRING(val)) {
+                    obj_string* string = AS_STRING(val);
+                    put_string(line, "\"");
+                    put_chars(line, string->chars, string->length < 24 ? string->length : 24);
+                    put_string(line, "\"");
+               } else {
+                    put_string(line, "<obj ");
+                    put_hex(line, (uintptr_t)AS_OBJ(val));
+                    put_string(line, ">");
+               }
+               return;
+     }
+     put_string(line, "?");
+}
+
+/*   writes the last 'count' records, oldest first. output goes straight to
+     the file descriptor, stdio may be in an unknown state */
+void dump_trace(int fd, int count, bool objects) {
+     uint64_t available = trace.count < TRACE_SIZE ? trace.count : TRACE_SIZE;
+     if ((uint64_t)count > available) count = (int)available;
+
+     trace_line line = { .length = 0 };
+     put_string(&line, "== last ");
+     put_unsigned(&line, (uint64_t)count, 0);
+     put_string(&line, " of ");
+     put_unsigned(&line, trace.count, 0);
+     put_string(&line, " instructions ==\n");
+     if (write(fd, line.chars, line.length) < 0) return;
+
+     for (uint64_t i = trace.count - count; i < trace.count; i++) {
+          trace_record* rec = &trace.records[i & (TRACE_SIZE - 1)];
+
+          line.length = 0;
+          put_unsigned(&line, rec->offset, 4);
+          put_string(&line, " ");
+          put_padded(&line, opcode_name(rec->opcode), 16);
+          put_string(&line, " in ");
+          put_function(&line, rec->function, objects);
+          put_string(&line, " depth ");
+          put_unsigned(&line, rec->depth, 0);
+          put_string(&line, " top ");
+          if (rec->depth > 0) {
+               put_top(&line, rec, objects);
+          } else {
+               put_string(&line, "-");
+          }
+          line.chars[line.length++] = '\n';
+
+          if (write(fd, line.chars, line.length) < 0) return;
+     }
+}
+
+/*   the signal can arrive in the middle of a table resize or an allocation,
+     so the dump is left to the dispatch loop, which makes it before the next
+     instruction with the heap in a consistent state */
+static void dump_on_signal(int sig) {
+     (void)sig;
+     trace.dump_requested = 1;
+}
+
+//dumps the trace and then lets the default action terminate the process
+static void dump_on_fatal_signal(int sig) {
+     dump_trace(STDERR_FILENO, trace.dump_count, false);
+     signal(sig, SIG_DFL);
+     raise(sig);
+}
+
+/*   SIGUSR1 dumps the ring buffer of a running script without stopping it,
+     crashes dump it on the way down */
+void install_trace_handlers() {
+     signal(SIGUSR1, dump_on_signal);
+     signal(SIGSEGV, dump_on_fatal_signal);
+     signal(SIGBUS, dump_on_fatal_signal);
+     signal(SIGFPE, dump_on_fatal_signal);
+     signal(SIGABRT, dump_on_fatal_signal);
+}
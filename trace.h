@@ -0,0 +1,63 @@
+#ifndef klox_trace_h
+#define klox_trace_h
+
+#include <signal.h>
+#include <string.h>
+
+#include "common.h"
+#include "object.h"
+#include "value.h"
+
+//number of records kept, must be a power of two
+#define TRACE_SIZE 4096
+#define TRACE_DUMP_DEFAULT 32
+
+//one executed instruction, kept small so recording it is a few stores
+typedef struct {
+     obj_function* function;  //whose chunk 'offset' is in
+     uint32_t offset;         //offset of the instruction in its chunk
+     uint32_t depth;          //stack depth before the instruction ran
+     uint8_t opcode;
+     uint8_t top_type;        //type tag of the value on top of the stack
+     uint64_t top_bits;       //raw payload of that value
+} trace_record;
+
+typedef struct {
+     trace_record records[TRACE_SIZE];
+     uint64_t count;          //total records written, wraps around the ring
+     bool enabled;
+     int dump_count;          //how many records to decode on a dump
+     volatile sig_atomic_t dump_requested;  //SIGUSR1 arrived, see run_loop
+} tracer;
+
+extern tracer trace;
+
+void enable_trace(int dump_count);
+void install_trace_handlers(void);
+
+/*   writes the last 'count' records. a dump from a crash handler passes
+     'objects' false, it then prints objects and functions as addresses
+     instead of reading a heap that may be what crashed */
+void dump_trace(int fd, int count, bool objects);
+
+//appends a record to the ring buffer, overwriting the oldest one
+static inline void trace_instruction(obj_function* function, uint32_t offset,
+                                     uint8_t opcode, int depth, value* top) {
+     trace_record* rec = &trace.records[trace.count & (TRACE_SIZE - 1)];
+     rec->function = function;
+     rec->offset = offset;
+     rec->opcode = opcode;
+     rec->depth = (uint32_t)depth;
+
+     if (depth > 0) {
+          rec->top_type = (uint8_t)top->type;
+          memcpy(&rec->top_bits, &top->as, sizeof(rec->top_bits));
+     } else {
+          rec->top_type = (uint8_t)VAL_NULL;
+          rec->top_bits = 0;
+     }
+
+     trace.count++;
+}
+
+#endif
@@ -3,16 +3,28 @@
 
 #include "object.h"
 #include "memory.h"
+#include "number.h"
+#include "output.h"
 #include "value.h"
 
 bool values_equal(value a, value b) {
-     if (a.type != b.type) return false;
+     if (a.type != b.type) {
+          //an integer equals the double with the same value
+          if (IS_NUMBER(a) && IS_NUMBER(b)) return AS_NUMBER(a) == AS_NUMBER(b);
+          return false;
+     }
 
      switch (a.type) {
           case VAL_BOOL:      return AS_BOOL(a) == AS_BOOL(b);
           case VAL_NULL:      return true;
-          case VAL_NUMBER:    return AS_NUMBER(a) == AS_NUMBER(b);
-          case VAL_OBJ:       return AS_OBJ(a) == AS_OBJ(b);
+          case VAL_NUMBER:    return AS_DOUBLE(a) == AS_DOUBLE(b);
+          case VAL_INT:       return AS_INT(a) == AS_INT(b);
+          case VAL_OBJ:
+               if (AS_OBJ(a) == AS_OBJ(b)) return true;
+               //two interned strings are only equal if they are the same one
+               if (!IS_STRING(a) || !IS_STRING(b)) return false;
+               if (AS_STRING(a)->interned && AS_STRING(b)->interned) return false;
+               return strings_equal(AS_STRING(a), AS_STRING(b));
      }
 }
 
@@ -40,11 +52,27 @@ void free_val_array(val_array* array) {
      init_val_array(array);
 }
 
-void print_value(value val) {
+void write_value(out_buffer* out, value val) {
      switch (val.type) {
-          case VAL_BOOL:   printf(AS_BOOL(val) ? "true" : "false"); break;
-          case VAL_NULL:   printf("null"); break;
-          case VAL_NUMBER: printf("%g", AS_NUMBER(val)); break;
-          case VAL_OBJ:    print_object(val); break;
+          case VAL_BOOL:
+               if (AS_BOOL(val)) write_chars(out, "true", 4);
+               else write_chars(out, "false", 5);
+               break;
+          case VAL_NULL:   write_chars(out, "null", 4); break;
+          case VAL_NUMBER:
+          case VAL_INT: {
+               char buffer[NUMBER_BUFFER_SIZE];
+               write_chars(out, buffer, format_number(AS_NUMBER(val), buffer));
+               break;
+          }
+          case VAL_OBJ:    write_object(out, val); break;
      }
 }
+
+//unbuffered variant used by the disassembler
+void print_value(value val) {
+     out_buffer out;
+     init_output(&out, stdout);
+     write_value(&out, val);
+     free_output(&out);
+}
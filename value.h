@@ -4,21 +4,25 @@
 #include "common.h"
 
 typedef struct s_obj obj;
+typedef struct s_out_buffer out_buffer;
 typedef struct s_obj_string obj_string;
 
 typedef enum {
      VAL_BOOL,
      VAL_NULL,
      VAL_NUMBER,
+     VAL_INT,
      VAL_OBJ,
 } val_type;
 
-//a tagged union that lets us represent different values
-typedef struct {
+//a tagged union that lets us represent different values, klox.h names it
+//klox_value without showing what is inside
+typedef struct s_value {
      val_type type;           //type tag
      union {                  //union field that contains underlying values
           bool boolean;
           double number;
+          int64_t integer;
           obj* object;
      } as;
 } value;
@@ -26,20 +30,83 @@ typedef struct {
 //these macros verify that we are using are the correct type
 #define IS_BOOL(val)    ((val).type == VAL_BOOL)
 #define IS_NULL(val)    ((val).type == VAL_NULL)
-#define IS_NUMBER(val)  ((val).type == VAL_NUMBER)
+#define IS_DOUBLE(val)  ((val).type == VAL_NUMBER)
+#define IS_INT(val)     ((val).type == VAL_INT)
+#define IS_NUMBER(val)  (IS_DOUBLE(val) || IS_INT(val))
 #define IS_OBJ(val)     ((val).type == VAL_OBJ)
 
 //these macros unwrap klox values back to C values
 #define AS_OBJ(val)     ((val).as.object)
 #define AS_BOOL(val)    ((val).as.boolean)
-#define AS_NUMBER(val)  ((val).as.number)
+#define AS_DOUBLE(val)  ((val).as.number)
+#define AS_INT(val)     ((val).as.integer)
+#define AS_NUMBER(val)  as_number(val)
 
 //these macros promots native C values to klox values
 #define BOOL_VAL(val)   ((value){ VAL_BOOL, { .boolean = val } })
 #define NULL_VAL        ((value){ VAL_NULL, { .number = 0 } })
 #define NUMBER_VAL(val) ((value){ VAL_NUMBER, { .number = val } })
+#define INT_VAL(val)    ((value){ VAL_INT, { .integer = val } })
 #define OBJ_VAL(val)    ((value){ VAL_OBJ, { .object = (obj*)val } })
 
+/*   integers are kept within +-2^53, where every one of them is also exactly
+     representable as a double. that is what makes them indistinguishable from
+     the doubles they replace: an operation whose result would leave this range
+     is done in floating point instead, and gives the same double it always
+     did */
+#define INT_LIMIT (INT64_C(1) << 53)
+
+//the value of any number, integer or not, as a double
+static inline double as_number(value val) {
+     return IS_INT(val) ? (double)AS_INT(val) : AS_DOUBLE(val);
+}
+
+static inline value int_or_double(int64_t result) {
+     if (result > INT_LIMIT || result < -INT_LIMIT) {
+          return NUMBER_VAL((double)result);
+     }
+     return INT_VAL(result);
+}
+
+//the arithmetic helpers below expect both operands to be numbers
+static inline value add_numbers(value a, value b) {
+     if (IS_INT(a) && IS_INT(b)) return int_or_double(AS_INT(a) + AS_INT(b));
+     return NUMBER_VAL(AS_NUMBER(a) + AS_NUMBER(b));
+}
+
+static inline value subtract_numbers(value a, value b) {
+     if (IS_INT(a) && IS_INT(b)) return int_or_double(AS_INT(a) - AS_INT(b));
+     return NUMBER_VAL(AS_NUMBER(a) - AS_NUMBER(b));
+}
+
+static inline value multiply_numbers(value a, value b) {
+     if (IS_INT(a) && IS_INT(b)) {
+          int64_t result;
+          if (!__builtin_mul_overflow(AS_INT(a), AS_INT(b), &result)) {
+               //a zero product of operands with different signs is -0
+               if (result == 0 && ((AS_INT(a) < 0) != (AS_INT(b) < 0))) {
+                    return NUMBER_VAL(-0.0);
+               }
+               return int_or_double(result);
+          }
+     }
+     return NUMBER_VAL(AS_NUMBER(a) * AS_NUMBER(b));
+}
+
+static inline value divide_numbers(value a, value b) {
+     return NUMBER_VAL(AS_NUMBER(a) / AS_NUMBER(b));
+}
+
+static inline value negate_number(value a) {
+     if (IS_INT(a) && AS_INT(a) != 0) return INT_VAL(-AS_INT(a));
+     return NUMBER_VAL(-AS_NUMBER(a));
+}
+
+//null and false should evaluate to false, everything else is true
+static inline bool is_falsey(value val) {
+     return IS_NULL(val) || (IS_BOOL(val) && !AS_BOOL(val));
+}
+
 //val_array represents the constant pool associated with each chunk
 typedef struct {
      int count;
@@ -51,6 +118,7 @@ bool values_equal(value a, value b);
 void init_val_array(val_array* array);
 void write_val_array(val_array* array, value val);
 void free_val_array(val_array* array);
+void write_value(out_buffer* out, value val);
 void print_value(value val);
 
 #endif
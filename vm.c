@@ -1,46 +1,115 @@
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "common.h"
 #include "compiler.h"
+#include "coverage.h"
 #include "debug.h"
+#include "jit.h"
 #include "object.h"
 #include "memory.h"
+#include "natives.h"
+#include "perf.h"
+#include "stack.h"
+#include "trace.h"
 #include "vm.h"
 
 VM vm;
 
 static void reset_stack() {
      vm.stack_top = vm.stack;
+     vm.frame_count = 0;
 }
 
-//function for reporting runtime errorss
-static void runtime_error(const char* format, ...) {
+//how many calls a traceback shows at either end before it skips some
+#define TRACEBACK_ENDS 16
+
+//function for reporting runtime errorss, natives use it to fail a call
+void runtime_error(const char* format, ...) {
+     //keep what the script printed so far ahead of the error message
+     flush_output(&vm.out);
+
      va_list args;
      va_start(args, format);
      vfprintf(stderr, format, args);
      va_end(args);
      fputs("\n", stderr);
 
-     size_t instruction = vm.ip - vm.chunk->code - 1;
-     int line = vm.chunk->lines[instruction];
-     fprintf(stderr, "[line %d] in script\n", line);
+     for (int i = vm.frame_count - 1; i >= 0; i--) {
+          //runaway recursion reports its innermost and outermost calls
+          if (i == vm.frame_count - 1 - TRACEBACK_ENDS && i >= TRACEBACK_ENDS) {
+               fprintf(stderr, "[%d more calls]\n", i - TRACEBACK_ENDS + 1);
+               i = TRACEBACK_ENDS - 1;
+          }
+
+          call_frame* frame = &vm.frames[i];
+          obj_function* function = frame->function;
+          //a frame a stack overflow stopped may not have stored its ip yet
+          size_t instruction = frame->ip > function->chunk.code
+                               ? frame->ip - function->chunk.code - 1 : 0;
+          fprintf(stderr, "[line %d] in ", function->chunk.lines[instruction]);
+          if (function->name == NULL) {
+               fprintf(stderr, "script\n");
+          } else {
+               fprintf(stderr, "%s()\n", function->name->chars);
+          }
+     }
+
+     if (trace.enabled) dump_trace(fileno(stderr), trace.dump_count, true);
 
      reset_stack();
 }
 
 void init_vm() {
-     reset_stack();
+     if (!set_stack_size(STACK_SIZE_DEFAULT)) {
+          fprintf(stderr, "could not reserve the stack.\n");
+          exit(70);
+     }
+#ifdef DEBUG_TRACE_EXECUTION
+     enable_trace(TRACE_DUMP_DEFAULT);
+#endif
+#ifndef KLOX_COMPACT_HEAP
      vm.objects = NULL;
+#endif
      init_table(&vm.globals);
+     init_table(&vm.natives);
      init_table(&vm.strings);
+     init_output(&vm.out, stdout);
+     vm.jit = false;
+     define_natives();
+}
+
+//swaps the stack for one of 'size' bytes, false keeps the one there was
+bool set_stack_size(size_t size) {
+     void* frames;
+     if (!reserve_stack(size, sizeof(call_frame), &vm.stack, &frames)) {
+          return false;
+     }
+     vm.frames = frames;
+     reset_stack();
+     return true;
+}
+
+//binds a C function to a global name, scripts call it like any other function
+void define_native(const char* name, native_fn function, int arity) {
+     obj_string* string = copy_string(name, (int)strlen(name));
+     value native = OBJ_VAL(new_native(function, arity));
+     table_set(&vm.globals, string, native);
+     table_set(&vm.natives, string, native);
 }
 
 void free_vm() {
+     free_output(&vm.out);
+     free_natives();
      free_table(&vm.globals);
+     free_table(&vm.natives);
      free_table(&vm.strings);
      free_objects();
+     release_stack();
+     vm.stack = NULL;
+     vm.frames = NULL;
 }
 
 void push(value value) {
@@ -57,12 +126,7 @@ static value peek(int distance) {
      return vm.stack_top[-1 - distance];
 }
 
-//null and false should evaluate to false, everything else is true
-static bool is_falsey(value val) {
-     return IS_NULL(val) || (IS_BOOL(val) && !AS_BOOL(val));
-}
-
-static void concatenate() {
+void concatenate() {
      obj_string* b = AS_STRING(pop());
      obj_string* a = AS_STRING(pop());
 
@@ -72,41 +136,219 @@ static void concatenate() {
      memcpy(chars + a->length, b->chars, b->length);
      chars[length] = '\0';
 
-     obj_string* result = take_string(chars, length);
+     obj_string* result = length <= INTERN_MAX_LENGTH
+                          ? take_string(chars, length)
+                          : new_string(chars, length);
      push(OBJ_VAL(result));
 }
 
-static result run() {
-#define READ_BYTE() (*vm.ip++)
-#define READ_CONSTANT() (vm.chunk->constants.values[READ_BYTE()])
+/*   OP_CONCAT, a chain of 'count' additions. strings are joined with one
+     allocation and hashed once, numbers are added left to right like the
+     OP_ADDs the chain stands for. anything else leaves the stack alone and
+     returns false */
+bool add_all(int count) {
+     value* operands = vm.stack_top - count;
+     int length = 0;
+     int strings = 0;
+     for (int i = 0; i < count && IS_STRING(operands[i]); i++) {
+          length += AS_STRING(operands[i])->length;
+          strings++;
+     }
+
+     if (strings == count) {
+          char* chars = ALLOCATE(char, length + 1);
+          char* end = chars;
+          for (int i = 0; i < count; i++) {
+               obj_string* string = AS_STRING(operands[i]);
+               memcpy(end, string->chars, string->length);
+               end += string->length;
+          }
+          *end = '\0';
+
+          obj_string* result = length <= INTERN_MAX_LENGTH
+                               ? take_string(chars, length)
+                               : new_string(chars, length);
+          operands[0] = OBJ_VAL(result);
+     } else {
+          //the first pair that is not two numbers is where the OP_ADDs fail
+          for (int i = 0; i < count; i++) {
+               if (!IS_NUMBER(operands[i])) return false;
+          }
+          for (int i = 1; i < count; i++) {
+               operands[0] = add_numbers(operands[0], operands[i]);
+          }
+     }
+
+     vm.stack_top = operands + 1;
+     return true;
+}
+
+static bool call(obj_function* function, int arg_count) {
+     if (arg_count != function->arity) {
+          runtime_error("expected %d arguments but got %d",
+                        function->arity, arg_count);
+          return false;
+     }
+
+     if (vm.jit && function->jit == NULL) jit_compile(function);
+
+     call_frame* frame = &vm.frames[vm.frame_count++];
+     frame->function = function;
+     frame->ip = function->chunk.code;
+     frame->slots = vm.stack_top - arg_count - 1;
+     return true;
+}
+
+//checks that 'index' is a whole number within the bounds of 'array'
+bool array_index(obj_array* array, value index, int* slot) {
+     int64_t i;
+     if (IS_INT(index)) {
+          i = AS_INT(index);
+     } else if (IS_DOUBLE(index) && AS_DOUBLE(index) == (double)(int64_t)AS_DOUBLE(index)) {
+          i = (int64_t)AS_DOUBLE(index);
+     } else {
+          runtime_error("array index must be an integer");
+          return false;
+     }
+
+     if (i < 0 || i >= array->items.count) {
+          runtime_error("array index out of bounds");
+          return false;
+     }
+
+     *slot = (int)i;
+     return true;
+}
+
+//natives run in place on the stack, without a call frame of their own
+static bool call_native(obj_native* native, int arg_count) {
+     if (native->arity != NATIVE_VARIADIC && arg_count != native->arity) {
+          runtime_error("expected %d arguments but got %d",
+                        native->arity, arg_count);
+          return false;
+     }
+
+     value* args = vm.stack_top - arg_count;
+     if (!native->function(arg_count, args)) return false;
+     vm.stack_top = args;
+     return true;
+}
+
+bool call_value(value callee, int arg_count) {
+     if (IS_OBJ(callee)) {
+          switch (OBJ_TYPE(callee)) {
+               case OBJ_FUNCTION:
+                    return call(AS_FUNCTION(callee), arg_count);
+               case OBJ_NATIVE:
+                    return call_native(AS_NATIVE(callee), arg_count);
+               default:
+                    break;
+          }
+     }
+
+     runtime_error("can only call functions");
+     return false;
+}
+
+/*   the dispatch loop. it is always inlined into run() with a constant 'traced'
+     argument, so the untraced copy compiles without any trace check at all */
+static inline __attribute__((always_inline)) result run_loop(bool traced) {
+     //the current frame is cached in locals, and written back to the frame
+     //before anything else needs to see it (calls and errors)
+     call_frame* frame;
+     uint8_t* ip;
+     value* slots;
+     value* constants;
+
+#define LOAD_FRAME() \
+     do { \
+          frame = &vm.frames[vm.frame_count - 1]; \
+          ip = frame->ip; \
+          slots = frame->slots; \
+          constants = frame->function->chunk.constants.values; \
+     } while (false)
+#define STORE_FRAME() (frame->ip = ip)
+#define RUNTIME_ERROR(...) \
+     do { \
+          STORE_FRAME(); \
+          runtime_error(__VA_ARGS__); \
+          return RESULT_RUNTIME_ERROR; \
+     } while (false)
+//runs the current frame as machine code until it reaches an instruction the
+//JIT left to the interpreter. tracing wants to see every instruction
+#define ENTER_JIT() \
+     do { \
+          if (!traced && frame->function->jit != NULL) { \
+               STORE_FRAME(); \
+               jit_enter(frame); \
+               LOAD_FRAME(); \
+          } \
+     } while (false)
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() \
+     (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+#define READ_CONSTANT() (constants[READ_BYTE()])
 #define READ_STRING() AS_STRING(READ_CONSTANT())
-#define BINARY_OP(val_type, op) \
+#define BINARY_OP(fn) \
      do { \
           if (!IS_NUMBER(peek(0)) || !IS_NUMBER(peek(1))) { \
-               runtime_error("operands must be numbers"); \
-               return RESULT_RUNTIME_ERROR; \
+               RUNTIME_ERROR("operands must be numbers"); \
           } \
           \
+          value b = pop(); \
+          value a = pop(); \
+          push(fn(a, b)); \
+     } while (false)
+#define NUMBER_OP(fn) \
+     do { \
+          value b = pop(); \
+          value a = pop(); \
+          push(fn(a, b)); \
+     } while (false)
+#define COMPARE_NUMBERS(op) \
+     do { \
+          if (IS_INT(peek(0)) && IS_INT(peek(1))) { \
+               int64_t b = AS_INT(pop()); \
+               int64_t a = AS_INT(pop()); \
+               push(BOOL_VAL(a op b)); \
+               break; \
+          } \
           double b = AS_NUMBER(pop()); \
           double a = AS_NUMBER(pop()); \
-          push(val_type(a op b)); \
+          push(BOOL_VAL(a op b)); \
+     } while (false)
+#define COMPARE_OP(op) \
+     do { \
+          if (IS_INT(peek(0)) && IS_INT(peek(1))) { \
+               int64_t b = AS_INT(pop()); \
+               int64_t a = AS_INT(pop()); \
+               push(BOOL_VAL(a op b)); \
+               break; \
+          } \
+          if (!IS_NUMBER(peek(0)) || !IS_NUMBER(peek(1))) { \
+               RUNTIME_ERROR("operands must be numbers"); \
+          } \
+          \
+          double b = AS_NUMBER(pop()); \
+          double a = AS_NUMBER(pop()); \
+          push(BOOL_VAL(a op b)); \
      } while (false)
 
+     LOAD_FRAME();
+     ENTER_JIT();
 
      for (;;) {
-#ifdef DEBUG_TRACE_EXECUTION
-          printf("            ");
-
-          for (value* slot = vm.stack; slot < vm.stack_top; slot++) {
-               printf("[ ");
-               print_value(*slot);
-               printf(" ]");
+          if (traced) {
+               trace_instruction(frame->function,
+                                 (uint32_t)(ip - frame->function->chunk.code), *ip,
+                                 (int)(vm.stack_top - vm.stack),
+                                 vm.stack_top - 1);
+               if (trace.dump_requested) {
+                    trace.dump_requested = 0;
+                    dump_trace(fileno(stderr), trace.dump_count, true);
+               }
           }
 
-          printf("\n");
-
-          disassemble_instruction(vm.chunk, (int)(vm.ip - vm.chunk->code));
-#endif
           uint8_t instruction;
           switch (instruction = READ_BYTE()) {
                case OP_CONSTANT: {
@@ -114,26 +356,32 @@ static result run() {
                     push(constant);
                     break;
                }
+               case OP_CONSTANT_LONG: {
+                    int index = READ_BYTE();
+                    index |= READ_BYTE() << 8;
+                    index |= READ_BYTE() << 16;
+                    push(constants[index]);
+                    break;
+               }
                case OP_NULL:   push(NULL_VAL); break;
                case OP_TRUE:   push(BOOL_VAL(true)); break;
                case OP_FALSE:  push(BOOL_VAL(false)); break;
                case OP_POP:    pop(); break;
                case OP_GET_LOCAL: {
                     uint8_t slot = READ_BYTE();
-                    push(vm.stack[slot]);
+                    push(slots[slot]);
                     break;
                }
                case OP_SET_LOCAL: {
                     uint8_t slot = READ_BYTE();
-                    vm.stack[slot] = peek(0);
+                    slots[slot] = peek(0);
                     break;
                }
                case OP_GET_GLOBAL: {
                     obj_string* name = READ_STRING();
                     value val;
                     if (!table_get(&vm.globals, name, &val)) {
-                         runtime_error("undefined variable '%s'", name->chars);
-                         return RESULT_RUNTIME_ERROR;
+                         RUNTIME_ERROR("undefined variable '%s'", name->chars);
                     }
                     push(val);
                     break;
@@ -148,8 +396,7 @@ static result run() {
                     obj_string* name = READ_STRING();
                     if (table_set(&vm.globals, name, peek(0))) {
                          table_delete(&vm.globals, name);
-                         runtime_error("undefined variable '%s'", name->chars);
-                         return RESULT_RUNTIME_ERROR;
+                         RUNTIME_ERROR("undefined variable '%s'", name->chars);
                     }
                     break;
                }
@@ -161,66 +408,277 @@ static result run() {
                }
                case OP_NEGATE: {
                     if (!IS_NUMBER(peek(0))) {
-                         runtime_error("operand must be a number");
-                         return RESULT_RUNTIME_ERROR;
+                         RUNTIME_ERROR("operand must be a number");
                     }
 
-                    push(NUMBER_VAL(-AS_NUMBER(pop())));
+                    push(negate_number(pop()));
                     break;
                }
-               case OP_GREATER:    BINARY_OP(BOOL_VAL, >); break;
-               case OP_LESS:       BINARY_OP(BOOL_VAL, <); break;
+               case OP_GREATER:    COMPARE_OP(>); break;
+               case OP_LESS:       COMPARE_OP(<); break;
                case OP_ADD: {
                     if (IS_STRING(peek(0)) && IS_STRING(peek(1))) {
                          concatenate();
                     } else if (IS_NUMBER(peek(0)) && IS_NUMBER(peek(1))) {
-                         double b = AS_NUMBER(pop());
-                         double a = AS_NUMBER(pop());
-                         push(NUMBER_VAL(a + b));
+                         value b = pop();
+                         value a = pop();
+                         push(add_numbers(a, b));
                     } else {
-                         runtime_error("operands to addition must be numbers or strings");
-                         return RESULT_RUNTIME_ERROR;
+                         RUNTIME_ERROR("operands to addition must be numbers or strings");
                     }
                     break;
                }
-               case OP_SUBTRACT:   BINARY_OP(NUMBER_VAL, -); break;
-               case OP_MULTIPLY:   BINARY_OP(NUMBER_VAL, *); break;
-               case OP_DIVIDE:     BINARY_OP(NUMBER_VAL, /); break;
+               case OP_CONCAT: {
+                    if (!add_all(READ_BYTE())) {
+                         RUNTIME_ERROR("operands to addition must be numbers or strings");
+                    }
+                    break;
+               }
+               case OP_SUBTRACT:   BINARY_OP(subtract_numbers); break;
+               case OP_MULTIPLY:   BINARY_OP(multiply_numbers); break;
+               case OP_DIVIDE:     BINARY_OP(divide_numbers); break;
                case OP_NOT: {
                     push(BOOL_VAL(is_falsey(pop())));
                     break;
                }
+
+               //the compiler proved the operand types of these, so they
+               //skip the checks of the opcodes above
+               case OP_ADD_NUM:       NUMBER_OP(add_numbers); break;
+               case OP_ADD_STR:       concatenate(); break;
+               case OP_SUBTRACT_NUM:  NUMBER_OP(subtract_numbers); break;
+               case OP_MULTIPLY_NUM:  NUMBER_OP(multiply_numbers); break;
+               case OP_DIVIDE_NUM:    NUMBER_OP(divide_numbers); break;
+               case OP_GREATER_NUM:   COMPARE_NUMBERS(>); break;
+               case OP_LESS_NUM:      COMPARE_NUMBERS(<); break;
+               case OP_NOT_BOOL: {
+                    vm.stack_top[-1] = BOOL_VAL(!AS_BOOL(vm.stack_top[-1]));
+                    break;
+               }
+               case OP_NEGATE_NUM:    push(negate_number(pop())); break;
+
                case OP_PRINT: {
-                    print_value(pop());
-                    printf("\n");
+                    write_value(&vm.out, pop());
+                    write_char(&vm.out, '\n');
+                    break;
+               }
+               case OP_JUMP: {
+                    uint16_t offset = READ_SHORT();
+                    ip += offset;
+                    break;
+               }
+               case OP_JUMP_IF_FALSE: {
+                    uint16_t offset = READ_SHORT();
+                    if (is_falsey(peek(0))) ip += offset;
+                    break;
+               }
+               case OP_LOOP: {
+                    uint16_t offset = READ_SHORT();
+                    ip -= offset;
+                    ENTER_JIT();
+                    break;
+               }
+               case OP_JUMP_IF_LOCAL_NOT_LESS: {
+                    value* local = &slots[READ_BYTE()];
+                    value limit = READ_CONSTANT();
+                    uint16_t offset = READ_SHORT();
+
+                    if (IS_INT(*local) && IS_INT(limit)) {
+                         if (!(AS_INT(*local) < AS_INT(limit))) ip += offset;
+                    } else if (IS_NUMBER(*local)) {
+                         if (!(AS_NUMBER(*local) < AS_NUMBER(limit))) {
+                              ip += offset;
+                         }
+                    } else {
+                         RUNTIME_ERROR("operands must be numbers");
+                    }
+                    break;
+               }
+               case OP_INCREMENT_LOCAL_LOOP: {
+                    value* local = &slots[READ_BYTE()];
+                    value step = READ_CONSTANT();
+                    value limit = READ_CONSTANT();
+                    uint16_t offset = READ_SHORT();
+
+                    if (!IS_NUMBER(*local)) {
+                         RUNTIME_ERROR("operands to addition must be numbers or strings");
+                    }
+
+                    *local = add_numbers(*local, step);
+                    if (IS_INT(*local) && IS_INT(limit)) {
+                         if (AS_INT(*local) < AS_INT(limit)) ip -= offset;
+                    } else if (AS_NUMBER(*local) < AS_NUMBER(limit)) {
+                         ip -= offset;
+                    }
+                    ENTER_JIT();
+                    break;
+               }
+               case OP_COUNT: {
+                    int offset = (int)(ip - 1 - frame->function->chunk.code);
+                    coverage.counts[frame->function->chunk.lines[offset]]++;
+                    break;
+               }
+               case OP_BUILD_ARRAY: {
+                    int count = READ_BYTE();
+                    obj_array* array = new_array();
+                    for (value* element = vm.stack_top - count;
+                              element < vm.stack_top; element++) {
+                         write_val_array(&array->items, *element);
+                    }
+
+                    vm.stack_top -= count;
+                    push(OBJ_VAL(array));
+                    break;
+               }
+               case OP_INDEX_GET: {
+                    if (!IS_ARRAY(peek(1))) RUNTIME_ERROR("can only index arrays");
+
+                    obj_array* array = AS_ARRAY(peek(1));
+                    int slot;
+                    STORE_FRAME();
+                    if (!array_index(array, peek(0), &slot)) {
+                         return RESULT_RUNTIME_ERROR;
+                    }
+
+                    vm.stack_top -= 2;
+                    push(array->items.values[slot]);
+                    break;
+               }
+               case OP_INDEX_SET: {
+                    if (!IS_ARRAY(peek(2))) RUNTIME_ERROR("can only index arrays");
+
+                    obj_array* array = AS_ARRAY(peek(2));
+                    int slot;
+                    STORE_FRAME();
+                    if (!array_index(array, peek(1), &slot)) {
+                         return RESULT_RUNTIME_ERROR;
+                    }
+
+                    //the assignment evaluates to the assigned value
+                    value val = pop();
+                    array->items.values[slot] = val;
+                    vm.stack_top -= 2;
+                    push(val);
+                    break;
+               }
+               case OP_CALL: {
+                    int arg_count = READ_BYTE();
+                    STORE_FRAME();
+                    if (!call_value(peek(arg_count), arg_count)) {
+                         return RESULT_RUNTIME_ERROR;
+                    }
+                    LOAD_FRAME();
+                    ENTER_JIT();
+                    break;
+               }
+               case OP_TAIL_CALL: {
+                    int arg_count = READ_BYTE();
+                    value callee = peek(arg_count);
+                    if (!IS_FUNCTION(callee) ||
+                              AS_FUNCTION(callee)->arity != arg_count) {
+                         //natives have no frame to reuse, and errors are
+                         //reported by the ordinary call path
+                         STORE_FRAME();
+                         if (!call_value(callee, arg_count)) {
+                              return RESULT_RUNTIME_ERROR;
+                         }
+                         LOAD_FRAME();
+                         ENTER_JIT();
+                         break;
+                    }
+
+                    //slide the callee and its arguments down over the current
+                    //frame and reuse it, so tail recursion runs in constant space
+                    value* args = vm.stack_top - arg_count - 1;
+                    memmove(slots, args, sizeof(value) * (arg_count + 1));
+                    vm.stack_top = slots + arg_count + 1;
+                    frame->function = AS_FUNCTION(callee);
+                    frame->ip = frame->function->chunk.code;
+                    if (vm.jit && frame->function->jit == NULL) {
+                         jit_compile(frame->function);
+                    }
+                    LOAD_FRAME();
+                    ENTER_JIT();
                     break;
                }
                case OP_RETURN: {
-                    return RESULT_OK;
+                    value result = pop();
+                    vm.frame_count--;
+                    if (vm.frame_count == 0) {
+                         pop();
+                         return RESULT_OK;
+                    }
+
+                    vm.stack_top = slots;
+                    push(result);
+                    LOAD_FRAME();
+                    ENTER_JIT();
+                    break;
                }
           }
      }
 
+#undef LOAD_FRAME
+#undef STORE_FRAME
+#undef ENTER_JIT
+#undef RUNTIME_ERROR
 #undef READ_BYTE
+#undef READ_SHORT
 #undef READ_CONSTANT
-#undef REAS_STRING
+#undef READ_STRING
 #undef BINARY_OP
+#undef NUMBER_OP
+#undef COMPARE_NUMBERS
+#undef COMPARE_OP
 }
 
-result interpret(const char* source) {
-     chunk chunk;
-     init_chunk(&chunk);
+static result run() {
+     if (trace.enabled) return run_loop(true);
+     return run_loop(false);
+}
 
-     if (!compile(source, &chunk)) {
-          free_chunk(&chunk);
-          return RESULT_COMPILE_ERROR;
+//run() with pushes into the stack's guard page ending it, see stack.h
+static result guarded_run() {
+     if (sigsetjmp(overflow_jump, 0) != 0) {
+          runtime_error("stack overflow");
+          return RESULT_RUNTIME_ERROR;
      }
+     stack_guarded = true;
+     result result = run();
+     stack_guarded = false;
+     return result;
+}
 
-     vm.chunk = &chunk;
-     vm.ip = vm.chunk->code;
+//drops every global a script defined, and undoes assignments to natives
+void reset_globals() {
+     free_table(&vm.globals);
+     init_table(&vm.globals);
+     table_add_all(&vm.natives, &vm.globals);
+}
 
-     result result = run();
+//runs a compiled script, which is left intact so it can run again
+result execute(obj_function* script) {
+     push(OBJ_VAL(script));
+     call(script, 0);
+
+     result result = guarded_run();
+     flush_output(&vm.out);
+     return result;
+}
+
+result interpret(const char* source) {
+     if (perf.enabled) perf_start();
+     obj_function* function = compile(source);
+     if (function == NULL) {
+          if (perf.enabled) perf_stop();
+          return RESULT_COMPILE_ERROR;
+     }
+
+     result result = execute(function);
+     if (perf.enabled) perf_stop();
 
-     free_chunk(&chunk);
+     //only the functions it declared outlive the top-level code
+     free_chunk(&function->chunk);
+     jit_free(function);
      return result;
 }
@@ -1,20 +1,31 @@
 #ifndef klox_vm_h
 #define klox_vm_h
 
-#include "chunk.h"
+#include "object.h"
+#include "output.h"
 #include "table.h"
 #include "value.h"
 
-#define STACK_MAX 1024
+//a single ongoing function call
+typedef struct {
+     obj_function* function;
+     uint8_t* ip;                  //return address while a callee runs
+     value* slots;                 //first stack slot the function can use
+} call_frame;
 
 typedef struct {
-     chunk* chunk;                 //the chunk fed to the VM to be interpreted
-     uint8_t* ip;                  //instruction pointer
-     value stack[STACK_MAX];
+     call_frame* frames;           //one per stack slot, see stack.h
+     int frame_count;
+     value* stack;                 //reserved by init_vm, see stack.h
      value* stack_top;
      hash_table strings;
      hash_table globals;
-     obj* objects;
+     hash_table natives;           //the globals a fresh execution starts with
+#ifndef KLOX_COMPACT_HEAP
+     obj* objects;                 //the compact heap is walked instead
+#endif
+     out_buffer out;               //everything 'print' writes goes through here
+     bool jit;                     //compile functions to machine code on first call
 } VM;
 
 typedef enum {
@@ -26,9 +37,20 @@ typedef enum {
 extern VM vm;
 
 void init_vm(void);
+bool set_stack_size(size_t size);
+void define_native(const char* name, native_fn function, int arity);
+void runtime_error(const char* format, ...);
 void free_vm(void);
 result interpret(const char* source);
+result execute(obj_function* script);
+void reset_globals(void);
 void push(value value);
 value pop(void);
 
+//pieces of the interpreter that code compiled ahead of time runs on
+bool call_value(value callee, int arg_count);
+void concatenate(void);
+bool add_all(int count);
+bool array_index(obj_array* array, value index, int* slot);
+
 #endif